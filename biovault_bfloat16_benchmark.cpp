@@ -0,0 +1,730 @@
+/*******************************************************************************
+* Copyright 2020 LKEB, Leiden University Medical Center
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*******************************************************************************/
+
+// Benchmarks of the scalar and bulk conversions, and of the other kernels.
+//
+// Each benchmark reports "bytes_per_second" (the bytes read plus the bytes
+// written), "items_per_second", and, on x86, "elements_per_cycle" (based on
+// the time stamp counter, which counts reference cycles). Array sizes range
+// from L1-resident to DRAM-sized. For machine-readable output, run with
+//
+//   --benchmark_out=<file>.json --benchmark_out_format=json
+//
+// or build the target biovault_bfloat16_benchmark_json.
+
+#include "biovault_bfloat16.h"
+#include "biovault_bfloat16_bulk.h"
+#include "biovault_bfloat16_convolution.h"
+#include "biovault_bfloat16_csr.h"
+#include "biovault_bfloat16_io.h"
+#include "biovault_bfloat16_lazy_view.h"
+#include "biovault_bfloat16_parallel.h"
+#include "biovault_bfloat16_ring_buffer.h"
+#include "biovault_bfloat16_scan.h"
+#include "biovault_bfloat16_statistics.h"
+
+// Google Benchmark header file:
+#include <benchmark/benchmark.h>
+
+// Standard library header files:
+#include <cmath>   // For sqrt.
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <memory>  // For align.
+#include <random>
+#include <utility> // For move.
+#include <vector>
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#define BIOVAULT_BFLOAT16_BENCHMARK_HAS_RDTSC 1
+#elif defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define BIOVAULT_BFLOAT16_BENCHMARK_HAS_RDTSC 1
+#endif
+
+
+namespace
+{
+	using biovault::bfloat16_t;
+
+	using float_limits = std::numeric_limits<float>;
+
+	// Number of elements: 4 Ki (L1), 64 Ki (L2), 1 Mi (L3), and 32 Mi (DRAM).
+	constexpr std::int64_t l1_size{ std::int64_t{ 1 } << 12 };
+	constexpr std::int64_t dram_size{ std::int64_t{ 1 } << 25 };
+	constexpr int size_multiplier{ 16 };
+
+	// The mix of floats to be converted, specified by a benchmark argument.
+	enum data_mix : std::int64_t
+	{
+		normal_mix,
+		nan_mix,
+		subnormal_mix,
+		all_categories_mix
+	};
+
+
+	std::vector<float> generate_floats(const std::size_t size, const std::int64_t mix)
+	{
+		std::mt19937 generator;
+		std::uniform_real_distribution<float> normal_distribution(-1000.0f, 1000.0f);
+		std::uniform_int_distribution<std::uint32_t> bits_distribution;
+		std::vector<float> result(size);
+
+		for (auto& f : result)
+		{
+			switch (mix)
+			{
+			case nan_mix:
+				// One out of eight is NaN.
+				f = (bits_distribution(generator) % 8 == 0) ? float_limits::quiet_NaN() : normal_distribution(generator);
+				break;
+			case subnormal_mix:
+			{
+				const std::uint32_t bits{ bits_distribution(generator) & 0x807FFFFFU };
+				std::memcpy(&f, &bits, sizeof(f));
+				break;
+			}
+			case all_categories_mix:
+			{
+				// Random bits yield all categories, mostly normals.
+				const std::uint32_t bits{ bits_distribution(generator) };
+				std::memcpy(&f, &bits, sizeof(f));
+				break;
+			}
+			default:
+				f = normal_distribution(generator);
+			}
+		}
+		return result;
+	}
+
+
+	std::vector<bfloat16_t> generate_bfloat16_values(const std::size_t size, const std::int64_t mix)
+	{
+		const auto floats = generate_floats(size, mix);
+		std::vector<bfloat16_t> result(size);
+		biovault::convert_float_to_bfloat16(floats.data(), result.data(), size);
+		return result;
+	}
+
+
+	std::uint64_t read_cycle_counter()
+	{
+#ifdef BIOVAULT_BFLOAT16_BENCHMARK_HAS_RDTSC
+		return __rdtsc();
+#else
+		return 0;
+#endif
+	}
+
+
+	// Measures the time stamp counter cycles of a benchmark loop, and reports the
+	// throughput of the loop, when it is destructed.
+	class throughput_reporter
+	{
+	public:
+		throughput_reporter(benchmark::State& state, const std::size_t element_count, const std::size_t bytes_per_element)
+			:
+			state_(state),
+			element_count_(element_count),
+			bytes_per_element_(bytes_per_element),
+			start_cycles_(read_cycle_counter())
+		{
+		}
+
+		~throughput_reporter()
+		{
+			const auto cycles = read_cycle_counter() - start_cycles_ - paused_cycles_;
+			const auto total_element_count = static_cast<std::int64_t>(element_count_) * state_.iterations();
+
+			state_.SetItemsProcessed(total_element_count);
+			state_.SetBytesProcessed(total_element_count * static_cast<std::int64_t>(bytes_per_element_));
+
+			if (cycles > 0)
+			{
+				state_.counters["elements_per_cycle"] = static_cast<double>(total_element_count) / static_cast<double>(cycles);
+			}
+		}
+
+		throughput_reporter(const throughput_reporter&) = delete;
+		throughput_reporter& operator=(const throughput_reporter&) = delete;
+
+		// Pauses the timing of the state, and the cycle count, for example to
+		// restore the input of an in-place kernel between iterations.
+		void pause_timing()
+		{
+			state_.PauseTiming();
+			pause_start_cycles_ = read_cycle_counter();
+		}
+
+		void resume_timing()
+		{
+			paused_cycles_ += read_cycle_counter() - pause_start_cycles_;
+			state_.ResumeTiming();
+		}
+
+	private:
+		benchmark::State& state_;
+		std::size_t element_count_;
+		std::size_t bytes_per_element_;
+		std::uint64_t start_cycles_;
+		std::uint64_t pause_start_cycles_{};
+		std::uint64_t paused_cycles_{};
+	};
+
+
+	void add_mix_and_size_arguments(benchmark::internal::Benchmark* const benchmark)
+	{
+		benchmark->ArgNames({ "mix", "size" });
+
+		for (std::int64_t mix{ normal_mix }; mix <= all_categories_mix; ++mix)
+		{
+			for (auto size = l1_size; size <= dram_size; size *= size_multiplier)
+			{
+				benchmark->Args({ mix, size });
+			}
+		}
+	}
+
+
+	void add_size_arguments(benchmark::internal::Benchmark* const benchmark)
+	{
+		benchmark->ArgName("size")->RangeMultiplier(size_multiplier)->Range(l1_size, dram_size);
+	}
+
+
+	void add_size_and_thread_count_arguments(benchmark::internal::Benchmark* const benchmark)
+	{
+		benchmark->ArgNames({ "size", "threads" })->UseRealTime();
+
+		for (auto size = l1_size * size_multiplier; size <= dram_size; size *= size_multiplier)
+		{
+			for (const std::int64_t thread_count : { 1, 2, 4, 8, 16 })
+			{
+				benchmark->Args({ size, thread_count });
+			}
+		}
+	}
+
+
+	using float_to_bfloat16_kernel = void(*)(const float*, bfloat16_t*, std::size_t);
+	using bfloat16_to_float_kernel = void(*)(const bfloat16_t*, float*, std::size_t);
+
+
+	void BM_ScalarConstructorFromFloat(benchmark::State& state)
+	{
+		const auto size = static_cast<std::size_t>(state.range(1));
+		const auto floats = generate_floats(size, state.range(0));
+		std::vector<bfloat16_t> bfloat16_values(size);
+		const throughput_reporter reporter(state, size, sizeof(float) + sizeof(bfloat16_t));
+
+		for (auto _ : state)
+		{
+			for (std::size_t i{}; i < size; ++i)
+			{
+				bfloat16_values[i] = bfloat16_t{ floats[i] };
+			}
+			benchmark::DoNotOptimize(bfloat16_values.data());
+			benchmark::ClobberMemory();
+		}
+	}
+
+
+	// The integer constructor uses the fast rounding of normal floats and zero.
+	void BM_ScalarConstructorFromInteger(benchmark::State& state)
+	{
+		const auto size = static_cast<std::size_t>(state.range(0));
+		std::vector<std::int32_t> integers(size);
+		std::mt19937 generator;
+		std::uniform_int_distribution<std::int32_t> distribution;
+
+		for (auto& i : integers)
+		{
+			i = distribution(generator);
+		}
+		std::vector<bfloat16_t> bfloat16_values(size);
+		const throughput_reporter reporter(state, size, sizeof(std::int32_t) + sizeof(bfloat16_t));
+
+		for (auto _ : state)
+		{
+			for (std::size_t i{}; i < size; ++i)
+			{
+				bfloat16_values[i] = bfloat16_t{ integers[i] };
+			}
+			benchmark::DoNotOptimize(bfloat16_values.data());
+			benchmark::ClobberMemory();
+		}
+	}
+
+
+	void BM_ScalarConversionToFloat(benchmark::State& state)
+	{
+		const auto size = static_cast<std::size_t>(state.range(0));
+		const auto bfloat16_values = generate_bfloat16_values(size, all_categories_mix);
+		std::vector<float> floats(size);
+		const throughput_reporter reporter(state, size, sizeof(bfloat16_t) + sizeof(float));
+
+		for (auto _ : state)
+		{
+			for (std::size_t i{}; i < size; ++i)
+			{
+				floats[i] = bfloat16_values[i];
+			}
+			benchmark::DoNotOptimize(floats.data());
+			benchmark::ClobberMemory();
+		}
+	}
+
+
+	void BM_PlusCompoundAssignment(benchmark::State& state)
+	{
+		const auto size = static_cast<std::size_t>(state.range(0));
+		const auto floats = generate_floats(size, normal_mix);
+		auto bfloat16_values = generate_bfloat16_values(size, normal_mix);
+		const throughput_reporter reporter(state, size, sizeof(float) + 2 * sizeof(bfloat16_t));
+
+		for (auto _ : state)
+		{
+			for (std::size_t i{}; i < size; ++i)
+			{
+				bfloat16_values[i] += floats[i];
+			}
+			benchmark::DoNotOptimize(bfloat16_values.data());
+			benchmark::ClobberMemory();
+		}
+	}
+
+
+	void BM_ConvertFloatToBfloat16(benchmark::State& state, const float_to_bfloat16_kernel convert)
+	{
+		const auto size = static_cast<std::size_t>(state.range(1));
+		const auto floats = generate_floats(size, state.range(0));
+		std::vector<bfloat16_t> bfloat16_values(size);
+		const throughput_reporter reporter(state, size, sizeof(float) + sizeof(bfloat16_t));
+
+		for (auto _ : state)
+		{
+			convert(floats.data(), bfloat16_values.data(), size);
+			benchmark::DoNotOptimize(bfloat16_values.data());
+			benchmark::ClobberMemory();
+		}
+	}
+
+
+	void BM_ConvertBfloat16ToFloat(benchmark::State& state, const bfloat16_to_float_kernel convert)
+	{
+		const auto size = static_cast<std::size_t>(state.range(0));
+		const auto bfloat16_values = generate_bfloat16_values(size, all_categories_mix);
+		std::vector<float> floats(size);
+		const throughput_reporter reporter(state, size, sizeof(bfloat16_t) + sizeof(float));
+
+		for (auto _ : state)
+		{
+			convert(bfloat16_values.data(), floats.data(), size);
+			benchmark::DoNotOptimize(floats.data());
+			benchmark::ClobberMemory();
+		}
+	}
+
+
+	void BM_ConvertFloatToBfloat16AndClassify(benchmark::State& state)
+	{
+		const auto size = static_cast<std::size_t>(state.range(1));
+		const auto floats = generate_floats(size, state.range(0));
+		std::vector<bfloat16_t> bfloat16_values(size);
+		const throughput_reporter reporter(state, size, sizeof(float) + sizeof(bfloat16_t));
+
+		for (auto _ : state)
+		{
+			benchmark::DoNotOptimize(biovault::convert_float_to_bfloat16_and_classify(floats.data(), bfloat16_values.data(), size));
+			benchmark::ClobberMemory();
+		}
+	}
+
+
+	void BM_ConvertFloatToBfloat16Instrumented(benchmark::State& state)
+	{
+		const auto size = static_cast<std::size_t>(state.range(1));
+		const auto floats = generate_floats(size, state.range(0));
+		std::vector<bfloat16_t> bfloat16_values(size);
+		const throughput_reporter reporter(state, size, sizeof(float) + sizeof(bfloat16_t));
+
+		for (auto _ : state)
+		{
+			biovault::conversion_statistics statistics;
+			biovault::kernels::convert_float_to_bfloat16_instrumented(floats.data(), bfloat16_values.data(), size, statistics);
+			benchmark::DoNotOptimize(statistics);
+			benchmark::ClobberMemory();
+		}
+	}
+
+
+	template <biovault::bfloat16_classification(*classify)(const bfloat16_t*, std::size_t)>
+	void BM_Classify(benchmark::State& state)
+	{
+		const auto size = static_cast<std::size_t>(state.range(1));
+		const auto bfloat16_values = generate_bfloat16_values(size, state.range(0));
+		const throughput_reporter reporter(state, size, sizeof(bfloat16_t));
+
+		for (auto _ : state)
+		{
+			benchmark::DoNotOptimize(classify(bfloat16_values.data(), size));
+		}
+	}
+
+
+	template <std::size_t(*replace_non_finite)(bfloat16_t*, std::size_t, bfloat16_t)>
+	void BM_ReplaceNonFinite(benchmark::State& state)
+	{
+		const auto size = static_cast<std::size_t>(state.range(1));
+		const auto original_values = generate_bfloat16_values(size, state.range(0));
+		auto bfloat16_values = original_values;
+		throughput_reporter reporter(state, size, 2 * sizeof(bfloat16_t));
+
+		for (auto _ : state)
+		{
+			// Restores the non-finite values replaced by the previous iteration
+			// (without timing), so that each iteration sees the specified mix.
+			reporter.pause_timing();
+			std::memcpy(bfloat16_values.data(), original_values.data(), size * sizeof(bfloat16_t));
+			benchmark::ClobberMemory();
+			reporter.resume_timing();
+
+			benchmark::DoNotOptimize(replace_non_finite(bfloat16_values.data(), size, bfloat16_t{ 0.0f }));
+			benchmark::ClobberMemory();
+		}
+	}
+
+
+	void BM_ParallelConvertFloatToBfloat16(benchmark::State& state)
+	{
+		const auto size = static_cast<std::size_t>(state.range(0));
+		const auto thread_count = static_cast<unsigned>(state.range(1));
+		const auto floats = generate_floats(size, normal_mix);
+		std::vector<bfloat16_t> bfloat16_values(size);
+		const throughput_reporter reporter(state, size, sizeof(float) + sizeof(bfloat16_t));
+
+		for (auto _ : state)
+		{
+			biovault::parallel_convert_float_to_bfloat16(floats.data(), bfloat16_values.data(), size, thread_count);
+			benchmark::DoNotOptimize(bfloat16_values.data());
+			benchmark::ClobberMemory();
+		}
+	}
+
+
+	void BM_ParallelConvertBfloat16ToFloat(benchmark::State& state)
+	{
+		const auto size = static_cast<std::size_t>(state.range(0));
+		const auto thread_count = static_cast<unsigned>(state.range(1));
+		const auto bfloat16_values = generate_bfloat16_values(size, normal_mix);
+		std::vector<float> floats(size);
+		const throughput_reporter reporter(state, size, sizeof(bfloat16_t) + sizeof(float));
+
+		for (auto _ : state)
+		{
+			biovault::parallel_convert_bfloat16_to_float(bfloat16_values.data(), floats.data(), size, thread_count);
+			benchmark::DoNotOptimize(floats.data());
+			benchmark::ClobberMemory();
+		}
+	}
+
+
+	// Returns a kNN-graph-like square matrix with 'nonzero_count' non-zeros, and
+	// 16 random neighbours per row.
+	biovault::csr_matrix generate_knn_matrix(const std::size_t nonzero_count)
+	{
+		constexpr std::size_t neighbour_count{ 16 };
+		const auto row_count = nonzero_count / neighbour_count;
+		std::mt19937 generator;
+		std::uniform_int_distribution<biovault::csr_matrix::index_type> column_distribution(
+			0, static_cast<biovault::csr_matrix::index_type>(row_count - 1));
+		std::vector<std::size_t> row_offsets(row_count + 1);
+		std::vector<biovault::csr_matrix::index_type> column_indices(row_count * neighbour_count);
+
+		for (std::size_t row{}; row <= row_count; ++row)
+		{
+			row_offsets[row] = row * neighbour_count;
+		}
+		for (auto& column_index : column_indices)
+		{
+			column_index = column_distribution(generator);
+		}
+		const auto values = generate_floats(column_indices.size(), normal_mix);
+		return biovault::csr_matrix(row_count, row_count, std::move(row_offsets), std::move(column_indices), values);
+	}
+
+
+	void BM_Spmv(benchmark::State& state)
+	{
+		const auto matrix = generate_knn_matrix(static_cast<std::size_t>(state.range(0)));
+		const auto thread_count = static_cast<unsigned>(state.range(1));
+		const auto x = generate_floats(matrix.column_count(), normal_mix);
+		std::vector<float> y(matrix.row_count());
+
+		// Per non-zero: a bfloat16 value, a column index, and an element of x.
+		const throughput_reporter reporter(state, matrix.nonzero_count(),
+			sizeof(bfloat16_t) + sizeof(biovault::csr_matrix::index_type) + sizeof(float));
+
+		for (auto _ : state)
+		{
+			biovault::spmv(matrix, x.data(), y.data(), thread_count);
+			benchmark::DoNotOptimize(y.data());
+			benchmark::ClobberMemory();
+		}
+	}
+
+
+	template <typename T>
+	void BM_Spmm(benchmark::State& state)
+	{
+		constexpr std::size_t b_column_count{ 2 };
+		const auto matrix = generate_knn_matrix(static_cast<std::size_t>(state.range(0)));
+		const auto thread_count = static_cast<unsigned>(state.range(1));
+		const auto b_floats = generate_floats(matrix.column_count() * b_column_count, normal_mix);
+		std::vector<T> b(b_floats.size());
+		std::vector<float> c(matrix.row_count() * b_column_count);
+
+		for (std::size_t i{}; i < b.size(); ++i)
+		{
+			b[i] = T(b_floats[i]);
+		}
+		const throughput_reporter reporter(state, matrix.nonzero_count(),
+			sizeof(bfloat16_t) + sizeof(biovault::csr_matrix::index_type) + b_column_count * sizeof(T));
+
+		for (auto _ : state)
+		{
+			biovault::spmm(matrix, b.data(), b_column_count, c.data(), thread_count);
+			benchmark::DoNotOptimize(c.data());
+			benchmark::ClobberMemory();
+		}
+	}
+
+	void BM_Serialize(benchmark::State& state, const biovault::byte_order order)
+	{
+		const auto size = static_cast<std::size_t>(state.range(0));
+		const auto bfloat16_values = generate_bfloat16_values(size, all_categories_mix);
+		std::vector<std::uint8_t> bytes(size * sizeof(bfloat16_t));
+		const throughput_reporter reporter(state, size, 2 * sizeof(bfloat16_t));
+
+		for (auto _ : state)
+		{
+			biovault::serialize(bfloat16_values.data(), size, bytes.data(), order);
+			benchmark::DoNotOptimize(bytes.data());
+			benchmark::ClobberMemory();
+		}
+	}
+
+
+	void BM_Deserialize(benchmark::State& state, const biovault::byte_order order)
+	{
+		const auto size = static_cast<std::size_t>(state.range(0));
+		const auto bfloat16_values = generate_bfloat16_values(size, all_categories_mix);
+		std::vector<std::uint8_t> bytes(size * sizeof(bfloat16_t));
+		biovault::serialize(bfloat16_values.data(), size, bytes.data(), order);
+		std::vector<bfloat16_t> result(size);
+		const throughput_reporter reporter(state, size, 2 * sizeof(bfloat16_t));
+
+		for (auto _ : state)
+		{
+			biovault::deserialize(bytes.data(), size, result.data(), order);
+			benchmark::DoNotOptimize(result.data());
+			benchmark::ClobberMemory();
+		}
+	}
+
+	// Writes a float frame into the ring buffer, and reads it back through the
+	// zero-copy view, on a single thread (measuring the overhead per frame).
+	void BM_RingBufferWriteAndRead(benchmark::State& state)
+	{
+		const auto frame_size = static_cast<std::size_t>(state.range(0));
+		const auto floats = generate_floats(frame_size, normal_mix);
+		// The region must be aligned to a cache line.
+		const auto region_size = biovault::frame_ring_buffer::required_size(frame_size, 4);
+		std::vector<unsigned char> storage(region_size + 64);
+		void* region = storage.data();
+		auto storage_size = storage.size();
+		std::align(64, region_size, region, storage_size);
+		auto ring_buffer = biovault::frame_ring_buffer::initialize(region, region_size, frame_size, 4);
+		const throughput_reporter reporter(state, frame_size, sizeof(float) + sizeof(bfloat16_t));
+
+		for (auto _ : state)
+		{
+			ring_buffer.try_write(floats.data());
+			benchmark::DoNotOptimize(ring_buffer.try_begin_read());
+			ring_buffer.end_read();
+		}
+	}
+
+	// Blurs a square bfloat16 image (of state.range(0) pixels) by a Gaussian with sigma 2.
+	void BM_GaussianBlur2D(benchmark::State& state)
+	{
+		const auto width = static_cast<std::size_t>(std::sqrt(static_cast<double>(state.range(0))));
+		const auto thread_count = static_cast<unsigned>(state.range(1));
+		const auto image = generate_bfloat16_values(width * width, normal_mix);
+		const auto kernel = biovault::gaussian_kernel(2.0f);
+		std::vector<bfloat16_t> result(image.size());
+		const throughput_reporter reporter(state, image.size(), 2 * sizeof(bfloat16_t));
+
+		for (auto _ : state)
+		{
+			biovault::convolve_separable_2d(image.data(), result.data(), width, width, kernel, kernel,
+				biovault::boundary_mode::reflect, thread_count);
+			benchmark::DoNotOptimize(result.data());
+			benchmark::ClobberMemory();
+		}
+	}
+
+
+	// Reduces a square bfloat16 image (of state.range(0) pixels) to the next pyramid level.
+	void BM_Downsample2D(benchmark::State& state)
+	{
+		const auto width = static_cast<std::size_t>(std::sqrt(static_cast<double>(state.range(0))));
+		const auto thread_count = static_cast<unsigned>(state.range(1));
+		const auto image = generate_bfloat16_values(width * width, normal_mix);
+		std::vector<bfloat16_t> result(biovault::downsampled_size(width) * biovault::downsampled_size(width));
+		const throughput_reporter reporter(state, image.size(), sizeof(bfloat16_t));
+
+		for (auto _ : state)
+		{
+			biovault::downsample_2x_2d(image.data(), result.data(), width, width, biovault::boundary_mode::reflect, thread_count);
+			benchmark::DoNotOptimize(result.data());
+			benchmark::ClobberMemory();
+		}
+	}
+
+	// Sums the elements of a lazy_float_view, sequentially (state.range(1) == 1)
+	// or at random positions (state.range(1) == 0), as legacy float code would.
+	void BM_LazyFloatViewAccess(benchmark::State& state)
+	{
+		const auto size = static_cast<std::size_t>(state.range(0));
+		const bool is_sequential = (state.range(1) != 0);
+		const auto bfloat16_values = generate_bfloat16_values(size, normal_mix);
+		std::vector<std::size_t> indices(size);
+		std::mt19937 generator;
+		std::uniform_int_distribution<std::size_t> distribution(0, size - 1);
+
+		for (std::size_t i{}; i < size; ++i)
+		{
+			indices[i] = is_sequential ? i : distribution(generator);
+		}
+		const biovault::lazy_float_view view(bfloat16_values.data(), size);
+		const throughput_reporter reporter(state, size, sizeof(bfloat16_t));
+
+		for (auto _ : state)
+		{
+			float sum{};
+
+			for (const auto index : indices)
+			{
+				sum += view[index];
+			}
+			benchmark::DoNotOptimize(sum);
+		}
+	}
+
+
+	// Computes the inclusive prefix sums of state.range(0) bfloat16 values, into OutputType elements.
+	template <typename OutputType>
+	void BM_InclusiveScan(benchmark::State& state)
+	{
+		const auto size = static_cast<std::size_t>(state.range(0));
+		const auto thread_count = static_cast<unsigned>(state.range(1));
+		const auto bfloat16_values = generate_bfloat16_values(size, normal_mix);
+		std::vector<OutputType> result(size);
+		const throughput_reporter reporter(state, size, sizeof(bfloat16_t) + sizeof(OutputType));
+
+		for (auto _ : state)
+		{
+			biovault::inclusive_scan(bfloat16_values.data(), result.data(), size, thread_count);
+			benchmark::DoNotOptimize(result.data());
+			benchmark::ClobberMemory();
+		}
+	}
+
+
+	// Computes the integral image of a square bfloat16 image (of state.range(0) pixels).
+	void BM_IntegralImage(benchmark::State& state)
+	{
+		const auto width = static_cast<std::size_t>(std::sqrt(static_cast<double>(state.range(0))));
+		const auto thread_count = static_cast<unsigned>(state.range(1));
+		const auto image = generate_bfloat16_values(width * width, normal_mix);
+		std::vector<float> result(image.size());
+		const throughput_reporter reporter(state, image.size(), sizeof(bfloat16_t) + sizeof(float));
+
+		for (auto _ : state)
+		{
+			biovault::integral_image(image.data(), result.data(), width, width, thread_count);
+			benchmark::DoNotOptimize(result.data());
+			benchmark::ClobberMemory();
+		}
+	}
+}
+
+
+BENCHMARK(BM_ScalarConstructorFromFloat)->Apply(add_mix_and_size_arguments);
+BENCHMARK(BM_ScalarConstructorFromInteger)->Apply(add_size_arguments);
+BENCHMARK(BM_ScalarConversionToFloat)->Apply(add_size_arguments);
+BENCHMARK(BM_PlusCompoundAssignment)->Apply(add_size_arguments);
+
+BENCHMARK_CAPTURE(BM_ConvertFloatToBfloat16, scalar, biovault::kernels::scalar::convert_float_to_bfloat16)->Apply(add_mix_and_size_arguments);
+BENCHMARK_CAPTURE(BM_ConvertBfloat16ToFloat, scalar, biovault::kernels::scalar::convert_bfloat16_to_float)->Apply(add_size_arguments);
+BENCHMARK_TEMPLATE(BM_Classify, biovault::kernels::scalar::classify)->Apply(add_mix_and_size_arguments);
+BENCHMARK_TEMPLATE(BM_ReplaceNonFinite, biovault::kernels::scalar::replace_non_finite)->Apply(add_mix_and_size_arguments);
+
+#ifdef BIOVAULT_BFLOAT16_HAS_SSE2
+BENCHMARK_CAPTURE(BM_ConvertFloatToBfloat16, sse2, biovault::kernels::sse2::convert_float_to_bfloat16)->Apply(add_mix_and_size_arguments);
+BENCHMARK_CAPTURE(BM_ConvertBfloat16ToFloat, sse2, biovault::kernels::sse2::convert_bfloat16_to_float)->Apply(add_size_arguments);
+BENCHMARK_TEMPLATE(BM_Classify, biovault::kernels::sse2::classify)->Apply(add_mix_and_size_arguments);
+BENCHMARK_TEMPLATE(BM_ReplaceNonFinite, biovault::kernels::sse2::replace_non_finite)->Apply(add_mix_and_size_arguments);
+#endif
+
+#ifdef BIOVAULT_BFLOAT16_HAS_AVX2
+BENCHMARK_CAPTURE(BM_ConvertFloatToBfloat16, avx2, biovault::kernels::avx2::convert_float_to_bfloat16)->Apply(add_mix_and_size_arguments);
+BENCHMARK_CAPTURE(BM_ConvertBfloat16ToFloat, avx2, biovault::kernels::avx2::convert_bfloat16_to_float)->Apply(add_size_arguments);
+#endif
+
+BENCHMARK(BM_ConvertFloatToBfloat16AndClassify)->Apply(add_mix_and_size_arguments);
+BENCHMARK(BM_ConvertFloatToBfloat16Instrumented)->Apply(add_mix_and_size_arguments);
+BENCHMARK(BM_ParallelConvertFloatToBfloat16)->Apply(add_size_and_thread_count_arguments);
+BENCHMARK(BM_ParallelConvertBfloat16ToFloat)->Apply(add_size_and_thread_count_arguments);
+
+BENCHMARK(BM_Spmv)->Apply(add_size_and_thread_count_arguments);
+BENCHMARK_TEMPLATE(BM_Spmm, float)->Apply(add_size_and_thread_count_arguments);
+BENCHMARK_TEMPLATE(BM_Spmm, bfloat16_t)->Apply(add_size_and_thread_count_arguments);
+
+BENCHMARK_CAPTURE(BM_Serialize, little_endian, biovault::byte_order::little_endian)->Apply(add_size_arguments);
+BENCHMARK_CAPTURE(BM_Serialize, big_endian, biovault::byte_order::big_endian)->Apply(add_size_arguments);
+BENCHMARK_CAPTURE(BM_Deserialize, little_endian, biovault::byte_order::little_endian)->Apply(add_size_arguments);
+BENCHMARK_CAPTURE(BM_Deserialize, big_endian, biovault::byte_order::big_endian)->Apply(add_size_arguments);
+
+BENCHMARK(BM_RingBufferWriteAndRead)->Apply(add_size_arguments);
+
+BENCHMARK(BM_GaussianBlur2D)->Apply(add_size_and_thread_count_arguments);
+BENCHMARK(BM_Downsample2D)->Apply(add_size_and_thread_count_arguments);
+
+// Random access is only benchmarked for an array that fits in the cache (of 64 tiles of 4096 elements).
+BENCHMARK(BM_LazyFloatViewAccess)->ArgNames({ "size", "sequential" })->Args({ 1 << 16, 0 })->Args({ 1 << 16, 1 })->Args({ 1 << 24, 1 });
+
+BENCHMARK_TEMPLATE(BM_InclusiveScan, float)->Apply(add_size_and_thread_count_arguments);
+BENCHMARK_TEMPLATE(BM_InclusiveScan, bfloat16_t)->Apply(add_size_and_thread_count_arguments);
+BENCHMARK(BM_IntegralImage)->Apply(add_size_and_thread_count_arguments);
+
+BENCHMARK_MAIN();
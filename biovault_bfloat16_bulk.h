@@ -0,0 +1,530 @@
+#ifndef BIOVAULT_BFLOAT16_BULK_H_INCLUDE_GUARD
+#define BIOVAULT_BFLOAT16_BULK_H_INCLUDE_GUARD
+
+/*******************************************************************************
+* Copyright 2020 LKEB, Leiden University Medical Center
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*******************************************************************************/
+
+// Bulk operations on arrays of bfloat16_t: conversion from and to float, and
+// classification (NaN, infinity, zero, subnormal) and sanitisation of the
+// elements, based on their raw bits.
+//
+// Each operation has a portable scalar kernel (namespace kernels::scalar), and
+// SIMD kernels for SSE2 and AVX2 (namespaces kernels::sse2 and kernels::avx2),
+// when supported by the compiler flags. The functions directly in namespace
+// biovault use the best kernels that are available (kernels::native). All
+// kernels produce exactly the same bits as the scalar bfloat16_t(float)
+// constructor. The macro BIOVAULT_BFLOAT16_NO_SIMD disables the SIMD kernels.
+
+#include "biovault_bfloat16.h"
+
+#include <algorithm> // For min.
+#include <cstddef>   // For size_t.
+#include <cstdint>   // For uint16_t and uint32_t.
+#include <cstring>   // For memcpy.
+#include <vector>
+
+#ifndef BIOVAULT_BFLOAT16_NO_SIMD
+#	if defined(__AVX2__)
+#	define BIOVAULT_BFLOAT16_HAS_AVX2 1
+#	endif
+#	if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#	define BIOVAULT_BFLOAT16_HAS_SSE2 1
+#	endif
+#endif
+
+#ifdef BIOVAULT_BFLOAT16_HAS_SSE2
+#include <emmintrin.h>
+#endif
+#ifdef BIOVAULT_BFLOAT16_HAS_AVX2
+#include <immintrin.h>
+#endif
+
+namespace biovault {
+
+	// Category flags of a bfloat16_t value, determined by its raw bits. The flags
+	// may be combined by bitwise OR, to specify a set of categories.
+	namespace bfloat16_category {
+		enum : unsigned {
+			nan = 1U << 0U,
+			positive_infinity = 1U << 1U,
+			negative_infinity = 1U << 2U,
+			zero = 1U << 3U,
+			subnormal = 1U << 4U,
+			normal = 1U << 5U,
+			infinity = positive_infinity | negative_infinity,
+			non_finite = nan | infinity
+		};
+	}
+
+	// Number of elements per category, as counted by classify(data, size).
+	// Zero includes both +0 and -0. Normal values are not counted explicitly:
+	// they are the remaining elements.
+	struct bfloat16_classification {
+		std::size_t nan_count{};
+		std::size_t positive_infinity_count{};
+		std::size_t negative_infinity_count{};
+		std::size_t zero_count{};
+		std::size_t subnormal_count{};
+
+		std::size_t non_finite_count() const {
+			return nan_count + positive_infinity_count + negative_infinity_count;
+		}
+
+		bfloat16_classification& operator+=(const bfloat16_classification& other) {
+			nan_count += other.nan_count;
+			positive_infinity_count += other.positive_infinity_count;
+			negative_infinity_count += other.negative_infinity_count;
+			zero_count += other.zero_count;
+			subnormal_count += other.subnormal_count;
+			return *this;
+		}
+	};
+
+	namespace kernels {
+
+		// Number of elements processed per block by the fused operations, which
+		// first convert a block, and then classify or sanitise it while it is
+		// still in the L1 cache.
+		constexpr std::size_t fused_block_size{ 2048 };
+
+		namespace scalar {
+
+			constexpr const char* name() { return "scalar"; }
+
+			// Bit-level equivalent of the bfloat16_t(float) constructor: rounds
+			// normal values to nearest even, flushes subnormals to (signed) zero,
+			// and quiets NaNs.
+			inline BIOVAULT_BFLOAT16_CONSTEXPR std::uint16_t convert_float_bits(const std::uint32_t bits) {
+				return ((bits & 0x7FFFFFFFU) > 0x7F800000U) ? static_cast<std::uint16_t>((bits >> 16U) | 0x40U) :
+					((bits & 0x7FFFFFFFU) < 0x00800000U) ? static_cast<std::uint16_t>((bits >> 16U) & 0x8000U) :
+					static_cast<std::uint16_t>((bits + 0x7FFFU + ((bits >> 16U) & 1U)) >> 16U);
+			}
+
+			inline BIOVAULT_BFLOAT16_CONSTEXPR unsigned category_of_bits(const std::uint16_t bits) {
+				return ((bits & 0x7FFFU) > 0x7F80U) ? bfloat16_category::nan :
+					(bits == 0x7F80U) ? bfloat16_category::positive_infinity :
+					(bits == 0xFF80U) ? bfloat16_category::negative_infinity :
+					((bits & 0x7FFFU) == 0) ? bfloat16_category::zero :
+					((bits & 0x7FFFU) < 0x80U) ? bfloat16_category::subnormal :
+					bfloat16_category::normal;
+			}
+
+			inline void convert_float_to_bfloat16(const float* const src, bfloat16_t* const dst, const std::size_t size) {
+				for (std::size_t i{}; i < size; ++i) {
+					std::uint32_t bits;
+					std::memcpy(&bits, src + i, sizeof(bits));
+					dst[i] = bfloat16_t(convert_float_bits(bits), true);
+				}
+			}
+
+			inline void convert_bfloat16_to_float(const bfloat16_t* const src, float* const dst, const std::size_t size) {
+				for (std::size_t i{}; i < size; ++i) {
+					const std::uint32_t bits{ std::uint32_t{ get_raw_bits(src[i]) } << 16U };
+					std::memcpy(dst + i, &bits, sizeof(bits));
+				}
+			}
+
+			inline bfloat16_classification classify(const bfloat16_t* const data, const std::size_t size) {
+				bfloat16_classification result;
+
+				for (std::size_t i{}; i < size; ++i) {
+					switch (category_of_bits(get_raw_bits(data[i]))) {
+					case bfloat16_category::nan: ++result.nan_count; break;
+					case bfloat16_category::positive_infinity: ++result.positive_infinity_count; break;
+					case bfloat16_category::negative_infinity: ++result.negative_infinity_count; break;
+					case bfloat16_category::zero: ++result.zero_count; break;
+					case bfloat16_category::subnormal: ++result.subnormal_count; break;
+					default: break;
+					}
+				}
+				return result;
+			}
+
+			// Returns the index of the first element whose category is in the
+			// specified set of categories, or 'size' when there is no such element.
+			inline std::size_t find_first(const bfloat16_t* const data, const std::size_t size, const unsigned categories) {
+				for (std::size_t i{}; i < size; ++i) {
+					if ((category_of_bits(get_raw_bits(data[i])) & categories) != 0) {
+						return i;
+					}
+				}
+				return size;
+			}
+
+			// Replaces each NaN and infinity by the specified replacement value.
+			// Returns the number of replaced elements.
+			inline std::size_t replace_non_finite(bfloat16_t* const data, const std::size_t size, const bfloat16_t replacement) {
+				std::size_t count{};
+
+				for (std::size_t i{}; i < size; ++i) {
+					if ((get_raw_bits(data[i]) & 0x7F80U) == 0x7F80U) {
+						data[i] = replacement;
+						++count;
+					}
+				}
+				return count;
+			}
+		}
+
+#ifdef BIOVAULT_BFLOAT16_HAS_SSE2
+		namespace sse2 {
+
+			constexpr const char* name() { return "sse2"; }
+
+			// Converts four floats (specified by their bits) to bfloat16, leaving the
+			// resulting bits in the lower halves of the four 32-bit lanes.
+			inline __m128i convert_float_bits(const __m128i bits) {
+				const __m128i abs_bits = _mm_and_si128(bits, _mm_set1_epi32(0x7FFFFFFF));
+				const __m128i is_nan = _mm_cmpgt_epi32(abs_bits, _mm_set1_epi32(0x7F800000));
+				const __m128i is_zero_or_subnormal = _mm_cmplt_epi32(abs_bits, _mm_set1_epi32(0x00800000));
+				const __m128i upper_bits = _mm_srli_epi32(bits, 16);
+				const __m128i rounded = _mm_srli_epi32(_mm_add_epi32(_mm_add_epi32(bits, _mm_set1_epi32(0x7FFF)),
+					_mm_and_si128(upper_bits, _mm_set1_epi32(1))), 16);
+				const __m128i quieted = _mm_or_si128(upper_bits, _mm_set1_epi32(0x40));
+				const __m128i signed_zero = _mm_and_si128(upper_bits, _mm_set1_epi32(0x8000));
+
+				const __m128i result = _mm_or_si128(_mm_and_si128(is_nan, quieted), _mm_andnot_si128(is_nan, rounded));
+				return _mm_or_si128(_mm_and_si128(is_zero_or_subnormal, signed_zero), _mm_andnot_si128(is_zero_or_subnormal, result));
+			}
+
+			// Packs the lower halves of the 32-bit lanes of 'low' and 'high' into
+			// eight 16-bit lanes. (SSE2 only offers signed saturation, so the lanes
+			// are sign-extended first.)
+			inline __m128i pack_lower_halves(const __m128i low, const __m128i high) {
+				return _mm_packs_epi32(
+					_mm_srai_epi32(_mm_slli_epi32(low, 16), 16),
+					_mm_srai_epi32(_mm_slli_epi32(high, 16), 16));
+			}
+
+			inline void convert_float_to_bfloat16(const float* const src, bfloat16_t* const dst, const std::size_t size) {
+				std::size_t i{};
+
+				for (; i + 8 <= size; i += 8) {
+					const __m128i low = convert_float_bits(_mm_castps_si128(_mm_loadu_ps(src + i)));
+					const __m128i high = convert_float_bits(_mm_castps_si128(_mm_loadu_ps(src + i + 4)));
+					_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), pack_lower_halves(low, high));
+				}
+				scalar::convert_float_to_bfloat16(src + i, dst + i, size - i);
+			}
+
+			inline void convert_bfloat16_to_float(const bfloat16_t* const src, float* const dst, const std::size_t size) {
+				std::size_t i{};
+
+				for (; i + 8 <= size; i += 8) {
+					const __m128i bits = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+					_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_unpacklo_epi16(_mm_setzero_si128(), bits));
+					_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i + 4), _mm_unpackhi_epi16(_mm_setzero_si128(), bits));
+				}
+				scalar::convert_bfloat16_to_float(src + i, dst + i, size - i);
+			}
+
+			// All-ones lanes for the elements of each category, out of eight bfloat16 values.
+			struct category_masks {
+				__m128i nan;
+				__m128i positive_infinity;
+				__m128i negative_infinity;
+				__m128i zero;
+				__m128i subnormal;
+
+				explicit category_masks(const __m128i bits) {
+					const __m128i abs_bits = _mm_and_si128(bits, _mm_set1_epi16(0x7FFF));
+					nan = _mm_cmpgt_epi16(abs_bits, _mm_set1_epi16(0x7F80));
+					positive_infinity = _mm_cmpeq_epi16(bits, _mm_set1_epi16(0x7F80));
+					negative_infinity = _mm_cmpeq_epi16(bits, _mm_set1_epi16(static_cast<short>(0xFF80U)));
+					zero = _mm_cmpeq_epi16(abs_bits, _mm_setzero_si128());
+					subnormal = _mm_andnot_si128(zero, _mm_cmplt_epi16(abs_bits, _mm_set1_epi16(0x80)));
+				}
+
+				__m128i non_finite() const {
+					return _mm_or_si128(nan, _mm_or_si128(positive_infinity, negative_infinity));
+				}
+
+				__m128i select(const unsigned categories) const {
+					const auto flag_mask = [categories](const unsigned flag) {
+						return _mm_set1_epi16(((categories & flag) == 0) ? 0 : -1);
+					};
+					const __m128i normal = _mm_andnot_si128(_mm_or_si128(non_finite(), _mm_or_si128(zero, subnormal)), _mm_set1_epi16(-1));
+
+					return _mm_or_si128(
+						_mm_or_si128(
+							_mm_or_si128(_mm_and_si128(nan, flag_mask(bfloat16_category::nan)),
+								_mm_and_si128(positive_infinity, flag_mask(bfloat16_category::positive_infinity))),
+							_mm_or_si128(_mm_and_si128(negative_infinity, flag_mask(bfloat16_category::negative_infinity)),
+								_mm_and_si128(zero, flag_mask(bfloat16_category::zero)))),
+						_mm_or_si128(_mm_and_si128(subnormal, flag_mask(bfloat16_category::subnormal)),
+							_mm_and_si128(normal, flag_mask(bfloat16_category::normal))));
+				}
+			};
+
+			// Counts all-ones 16-bit lanes, accumulating them in the lanes of a
+			// register, and flushing them before any lane could overflow.
+			class lane_counter {
+			public:
+				void add(const __m128i mask) {
+					accumulator_ = _mm_sub_epi16(accumulator_, mask);
+					if (++pending_ == max_pending) {
+						flush();
+					}
+				}
+
+				std::size_t total() {
+					flush();
+					return total_;
+				}
+
+			private:
+				static constexpr unsigned max_pending{ 0x7FFF };
+
+				void flush() {
+					alignas(16) std::int32_t sums[4];
+					_mm_store_si128(reinterpret_cast<__m128i*>(sums), _mm_madd_epi16(accumulator_, _mm_set1_epi16(1)));
+					total_ += static_cast<std::size_t>(sums[0]) + static_cast<std::size_t>(sums[1]) +
+						static_cast<std::size_t>(sums[2]) + static_cast<std::size_t>(sums[3]);
+					accumulator_ = _mm_setzero_si128();
+					pending_ = 0;
+				}
+
+				__m128i accumulator_ = _mm_setzero_si128();
+				unsigned pending_{};
+				std::size_t total_{};
+			};
+
+			inline bfloat16_classification classify(const bfloat16_t* const data, const std::size_t size) {
+				lane_counter nan_counter;
+				lane_counter positive_infinity_counter;
+				lane_counter negative_infinity_counter;
+				lane_counter zero_counter;
+				lane_counter subnormal_counter;
+				std::size_t i{};
+
+				for (; i + 8 <= size; i += 8) {
+					const category_masks masks(_mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i)));
+					nan_counter.add(masks.nan);
+					positive_infinity_counter.add(masks.positive_infinity);
+					negative_infinity_counter.add(masks.negative_infinity);
+					zero_counter.add(masks.zero);
+					subnormal_counter.add(masks.subnormal);
+				}
+
+				bfloat16_classification result;
+				result.nan_count = nan_counter.total();
+				result.positive_infinity_count = positive_infinity_counter.total();
+				result.negative_infinity_count = negative_infinity_counter.total();
+				result.zero_count = zero_counter.total();
+				result.subnormal_count = subnormal_counter.total();
+				result += scalar::classify(data + i, size - i);
+				return result;
+			}
+
+			inline std::size_t find_first(const bfloat16_t* const data, const std::size_t size, const unsigned categories) {
+				std::size_t i{};
+
+				for (; i + 8 <= size; i += 8) {
+					const category_masks masks(_mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i)));
+					if (_mm_movemask_epi8(masks.select(categories)) != 0) {
+						return i + scalar::find_first(data + i, 8, categories);
+					}
+				}
+				return i + scalar::find_first(data + i, size - i, categories);
+			}
+
+			inline std::size_t replace_non_finite(bfloat16_t* const data, const std::size_t size, const bfloat16_t replacement) {
+				const __m128i replacement_bits = _mm_set1_epi16(static_cast<short>(get_raw_bits(replacement)));
+				const __m128i exponent_bits = _mm_set1_epi16(0x7F80);
+				lane_counter counter;
+				std::size_t i{};
+
+				for (; i + 8 <= size; i += 8) {
+					__m128i* const ptr = reinterpret_cast<__m128i*>(data + i);
+					const __m128i bits = _mm_loadu_si128(ptr);
+					const __m128i is_non_finite = _mm_cmpeq_epi16(_mm_and_si128(bits, exponent_bits), exponent_bits);
+
+					if (_mm_movemask_epi8(is_non_finite) != 0) {
+						_mm_storeu_si128(ptr, _mm_or_si128(_mm_and_si128(is_non_finite, replacement_bits), _mm_andnot_si128(is_non_finite, bits)));
+						counter.add(is_non_finite);
+					}
+				}
+				return counter.total() + scalar::replace_non_finite(data + i, size - i, replacement);
+			}
+		}
+#endif
+
+#ifdef BIOVAULT_BFLOAT16_HAS_AVX2
+		namespace avx2 {
+
+			constexpr const char* name() { return "avx2"; }
+
+			// Converts eight floats (specified by their bits) to bfloat16, leaving the
+			// resulting bits in the lower halves of the eight 32-bit lanes.
+			inline __m256i convert_float_bits(const __m256i bits) {
+				const __m256i abs_bits = _mm256_and_si256(bits, _mm256_set1_epi32(0x7FFFFFFF));
+				const __m256i is_nan = _mm256_cmpgt_epi32(abs_bits, _mm256_set1_epi32(0x7F800000));
+				const __m256i is_zero_or_subnormal = _mm256_cmpgt_epi32(_mm256_set1_epi32(0x00800000), abs_bits);
+				const __m256i upper_bits = _mm256_srli_epi32(bits, 16);
+				const __m256i rounded = _mm256_srli_epi32(_mm256_add_epi32(_mm256_add_epi32(bits, _mm256_set1_epi32(0x7FFF)),
+					_mm256_and_si256(upper_bits, _mm256_set1_epi32(1))), 16);
+				const __m256i quieted = _mm256_or_si256(upper_bits, _mm256_set1_epi32(0x40));
+				const __m256i signed_zero = _mm256_and_si256(upper_bits, _mm256_set1_epi32(0x8000));
+
+				return _mm256_blendv_epi8(_mm256_blendv_epi8(rounded, quieted, is_nan), signed_zero, is_zero_or_subnormal);
+			}
+
+			inline void convert_float_to_bfloat16(const float* const src, bfloat16_t* const dst, const std::size_t size) {
+				std::size_t i{};
+
+				for (; i + 16 <= size; i += 16) {
+					const __m256i low = convert_float_bits(_mm256_castps_si256(_mm256_loadu_ps(src + i)));
+					const __m256i high = convert_float_bits(_mm256_castps_si256(_mm256_loadu_ps(src + i + 8)));
+
+					// packus works per 128-bit lane, so the 64-bit quarters need to be reordered afterwards.
+					const __m256i packed = _mm256_permute4x64_epi64(_mm256_packus_epi32(low, high), 0xD8);
+					_mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), packed);
+				}
+				sse2::convert_float_to_bfloat16(src + i, dst + i, size - i);
+			}
+
+			inline void convert_bfloat16_to_float(const bfloat16_t* const src, float* const dst, const std::size_t size) {
+				std::size_t i{};
+
+				for (; i + 16 <= size; i += 16) {
+					const __m256i low = _mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i)));
+					const __m256i high = _mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i + 8)));
+					_mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), _mm256_slli_epi32(low, 16));
+					_mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i + 8), _mm256_slli_epi32(high, 16));
+				}
+				sse2::convert_bfloat16_to_float(src + i, dst + i, size - i);
+			}
+
+			// Classification is limited by memory bandwidth rather than by the
+			// vector width, so the SSE2 kernels are used.
+			using sse2::classify;
+			using sse2::find_first;
+			using sse2::replace_non_finite;
+		}
+#endif
+
+#if defined(BIOVAULT_BFLOAT16_HAS_AVX2)
+		namespace native = avx2;
+#elif defined(BIOVAULT_BFLOAT16_HAS_SSE2)
+		namespace native = sse2;
+#else
+		namespace native = scalar;
+#endif
+	}
+
+
+	// Converts 'size' floats to bfloat16, equivalent to calling the bfloat16_t(float)
+	// constructor for each of them.
+	inline void convert_float_to_bfloat16(const float* const src, bfloat16_t* const dst, const std::size_t size)
+	{
+		kernels::native::convert_float_to_bfloat16(src, dst, size);
+	}
+
+	// Converts 'size' floats to bfloat16, and classifies the converted elements
+	// while they are still in cache. Equivalent to convert_float_to_bfloat16
+	// followed by classify(dst, size), without a second pass over memory.
+	// Note that floats that are out of the range of bfloat16 are counted as
+	// infinity, and subnormal floats as zero.
+	inline bfloat16_classification convert_float_to_bfloat16_and_classify(const float* const src, bfloat16_t* const dst,
+		const std::size_t size)
+	{
+		bfloat16_classification classification;
+
+		for (std::size_t i{}; i < size; i += kernels::fused_block_size) {
+			const auto block_size = std::min(kernels::fused_block_size, size - i);
+			kernels::native::convert_float_to_bfloat16(src + i, dst + i, block_size);
+			classification += kernels::native::classify(dst + i, block_size);
+		}
+		return classification;
+	}
+
+	// Converts 'size' floats to bfloat16, replacing each converted NaN and infinity
+	// by the specified replacement value, in a single pass over memory.
+	// Returns the number of replaced elements.
+	inline std::size_t convert_float_to_bfloat16_replacing_non_finite(const float* const src, bfloat16_t* const dst,
+		const std::size_t size, const bfloat16_t replacement)
+	{
+		std::size_t count{};
+
+		for (std::size_t i{}; i < size; i += kernels::fused_block_size) {
+			const auto block_size = std::min(kernels::fused_block_size, size - i);
+			kernels::native::convert_float_to_bfloat16(src + i, dst + i, block_size);
+			count += kernels::native::replace_non_finite(dst + i, block_size, replacement);
+		}
+		return count;
+	}
+
+	// Converts 'size' bfloat16 values to float (lossless).
+	inline void convert_bfloat16_to_float(const bfloat16_t* const src, float* const dst, const std::size_t size)
+	{
+		kernels::native::convert_bfloat16_to_float(src, dst, size);
+	}
+
+	inline bfloat16_classification classify(const bfloat16_t* const data, const std::size_t size)
+	{
+		return kernels::native::classify(data, size);
+	}
+
+	// Returns the index of the first element whose category is in the specified set
+	// of bfloat16_category flags, or 'size' when there is no such element.
+	inline std::size_t find_first(const bfloat16_t* const data, const std::size_t size, const unsigned categories)
+	{
+		return kernels::native::find_first(data, size, categories);
+	}
+
+	inline std::size_t find_first_nan(const bfloat16_t* const data, const std::size_t size)
+	{
+		return find_first(data, size, bfloat16_category::nan);
+	}
+
+	inline std::size_t find_first_infinity(const bfloat16_t* const data, const std::size_t size)
+	{
+		return find_first(data, size, bfloat16_category::infinity);
+	}
+
+	inline std::size_t find_first_non_finite(const bfloat16_t* const data, const std::size_t size)
+	{
+		return find_first(data, size, bfloat16_category::non_finite);
+	}
+
+	inline std::size_t find_first_zero(const bfloat16_t* const data, const std::size_t size)
+	{
+		return find_first(data, size, bfloat16_category::zero);
+	}
+
+	// Returns the indices of all elements whose category is in the specified set
+	// of bfloat16_category flags, in ascending order.
+	inline std::vector<std::size_t> find_all(const bfloat16_t* const data, const std::size_t size, const unsigned categories)
+	{
+		std::vector<std::size_t> indices;
+
+		for (auto i = find_first(data, size, categories); i < size; ) {
+			indices.push_back(i);
+			++i;
+			i += find_first(data + i, size - i, categories);
+		}
+		return indices;
+	}
+
+	// Replaces each NaN and infinity in place by the specified replacement value.
+	// Returns the number of replaced elements.
+	inline std::size_t replace_non_finite(bfloat16_t* const data, const std::size_t size, const bfloat16_t replacement)
+	{
+		return kernels::native::replace_non_finite(data, size, replacement);
+	}
+}
+
+#endif
@@ -0,0 +1,294 @@
+/*******************************************************************************
+* Copyright 2020 LKEB, Leiden University Medical Center
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*******************************************************************************/
+
+// The file to be tested. Included twice here, to check its include guards!
+#include "biovault_bfloat16_bulk.h"
+#include "biovault_bfloat16_bulk.h"
+
+// GoogleTest header file:
+#include <gtest/gtest.h>
+
+// Standard library header files:
+#include <cmath>    // For fpclassify.
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <string>
+#include <vector>
+
+
+namespace
+{
+	using biovault::bfloat16_t;
+	namespace bfloat16_category = biovault::bfloat16_category;
+
+	using float_limits = std::numeric_limits<float>;
+
+	constexpr auto uint16_max = std::numeric_limits<std::uint16_t>::max();
+
+
+	std::uint32_t float_to_bits(const float arg)
+	{
+		std::uint32_t result;
+		std::memcpy(&result, &arg, sizeof(arg));
+		return result;
+	}
+
+
+	float bits_to_float(const std::uint32_t arg)
+	{
+		float result;
+		std::memcpy(&result, &arg, sizeof(arg));
+		return result;
+	}
+
+
+	// Returns all 2^16 bfloat16 values, ordered by their raw bits.
+	std::vector<bfloat16_t> all_bfloat16_values()
+	{
+		std::vector<bfloat16_t> result;
+		result.reserve(std::size_t{ uint16_max } + 1);
+
+		for (std::uint32_t bits{}; bits <= uint16_max; ++bits)
+		{
+			result.push_back(bfloat16_t(static_cast<std::uint16_t>(bits), true));
+		}
+		return result;
+	}
+
+
+	// Returns floats of all categories, including ones that round up, ties, and
+	// values that overflow to infinity. The number of elements is not a multiple
+	// of any SIMD width, so that the scalar tail of each kernel is tested as well.
+	std::vector<float> mixed_floats()
+	{
+		std::vector<float> result;
+
+		for (std::uint32_t bits{}; bits <= uint16_max; ++bits)
+		{
+			const auto upper_bits = bits << 16U;
+
+			for (const std::uint32_t lower_bits : { 0x0000U, 0x0001U, 0x7FFFU, 0x8000U, 0x8001U, 0xFFFFU })
+			{
+				result.push_back(bits_to_float(upper_bits | lower_bits));
+			}
+		}
+		result.push_back(float_limits::max());
+		result.push_back(float_limits::lowest());
+		result.push_back(float_limits::denorm_min());
+		return result;
+	}
+
+
+	template <typename ConversionFunction>
+	void assert_conversion_from_float_equals_constructor(const ConversionFunction convert)
+	{
+		const auto floats = mixed_floats();
+		std::vector<bfloat16_t> bfloat16_values(floats.size());
+
+		// Also test each size up to a few SIMD vectors, to cover the scalar tails.
+		for (std::size_t size{}; size < 40; ++size)
+		{
+			convert(floats.data(), bfloat16_values.data(), size);
+
+			for (std::size_t i{}; i < size; ++i)
+			{
+				ASSERT_EQ(get_raw_bits(bfloat16_values[i]), get_raw_bits(bfloat16_t{ floats[i] }));
+			}
+		}
+
+		convert(floats.data(), bfloat16_values.data(), floats.size());
+
+		for (std::size_t i{}; i < floats.size(); ++i)
+		{
+			SCOPED_TRACE(std::to_string(float_to_bits(floats[i])));
+			ASSERT_EQ(get_raw_bits(bfloat16_values[i]), get_raw_bits(bfloat16_t{ floats[i] }));
+		}
+	}
+
+
+	template <typename ConversionFunction>
+	void assert_conversion_to_float_equals_conversion_operator(const ConversionFunction convert)
+	{
+		const auto bfloat16_values = all_bfloat16_values();
+		std::vector<float> floats(bfloat16_values.size());
+
+		convert(bfloat16_values.data(), floats.data(), bfloat16_values.size());
+
+		for (std::size_t i{}; i < bfloat16_values.size(); ++i)
+		{
+			ASSERT_EQ(float_to_bits(floats[i]), std::uint32_t{ get_raw_bits(bfloat16_values[i]) } << 16U);
+		}
+	}
+
+
+	biovault::bfloat16_classification classify_by_fpclassify(const std::vector<bfloat16_t>& values)
+	{
+		biovault::bfloat16_classification result;
+
+		for (const auto value : values)
+		{
+			const float f{ value };
+
+			switch (std::fpclassify(f))
+			{
+			case FP_NAN: ++result.nan_count; break;
+			case FP_INFINITE: ++(std::signbit(f) ? result.negative_infinity_count : result.positive_infinity_count); break;
+			case FP_ZERO: ++result.zero_count; break;
+			case FP_SUBNORMAL: ++result.subnormal_count; break;
+			default: break;
+			}
+		}
+		return result;
+	}
+
+
+	void expect_equal_classification(const biovault::bfloat16_classification& actual, const biovault::bfloat16_classification& expected)
+	{
+		EXPECT_EQ(actual.nan_count, expected.nan_count);
+		EXPECT_EQ(actual.positive_infinity_count, expected.positive_infinity_count);
+		EXPECT_EQ(actual.negative_infinity_count, expected.negative_infinity_count);
+		EXPECT_EQ(actual.zero_count, expected.zero_count);
+		EXPECT_EQ(actual.subnormal_count, expected.subnormal_count);
+	}
+}
+
+
+GTEST_TEST(bfloat16_bulk, ConversionFromFloatEqualsConstructor)
+{
+	assert_conversion_from_float_equals_constructor(biovault::kernels::scalar::convert_float_to_bfloat16);
+#ifdef BIOVAULT_BFLOAT16_HAS_SSE2
+	assert_conversion_from_float_equals_constructor(biovault::kernels::sse2::convert_float_to_bfloat16);
+#endif
+#ifdef BIOVAULT_BFLOAT16_HAS_AVX2
+	assert_conversion_from_float_equals_constructor(biovault::kernels::avx2::convert_float_to_bfloat16);
+#endif
+	assert_conversion_from_float_equals_constructor(
+		static_cast<void(*)(const float*, bfloat16_t*, std::size_t)>(biovault::convert_float_to_bfloat16));
+}
+
+
+GTEST_TEST(bfloat16_bulk, ConversionToFloatEqualsConversionOperator)
+{
+	assert_conversion_to_float_equals_conversion_operator(biovault::kernels::scalar::convert_bfloat16_to_float);
+#ifdef BIOVAULT_BFLOAT16_HAS_SSE2
+	assert_conversion_to_float_equals_conversion_operator(biovault::kernels::sse2::convert_bfloat16_to_float);
+#endif
+#ifdef BIOVAULT_BFLOAT16_HAS_AVX2
+	assert_conversion_to_float_equals_conversion_operator(biovault::kernels::avx2::convert_bfloat16_to_float);
+#endif
+	assert_conversion_to_float_equals_conversion_operator(biovault::convert_bfloat16_to_float);
+}
+
+
+GTEST_TEST(bfloat16_bulk, ClassifyEqualsFpclassify)
+{
+	const auto values = all_bfloat16_values();
+	const auto expected = classify_by_fpclassify(values);
+
+	EXPECT_EQ(expected.nan_count, 2U * 127U);
+	EXPECT_EQ(expected.positive_infinity_count, 1U);
+	EXPECT_EQ(expected.negative_infinity_count, 1U);
+	EXPECT_EQ(expected.zero_count, 2U);
+	EXPECT_EQ(expected.subnormal_count, 2U * 127U);
+
+	expect_equal_classification(biovault::kernels::scalar::classify(values.data(), values.size()), expected);
+	expect_equal_classification(biovault::classify(values.data(), values.size()), expected);
+
+	// Classify more elements than a SIMD lane counter can hold before flushing.
+	std::vector<bfloat16_t> many_values;
+
+	for (int i{}; i < 5; ++i)
+	{
+		many_values.insert(many_values.end(), values.cbegin(), values.cend());
+	}
+	const auto actual = biovault::classify(many_values.data(), many_values.size());
+	EXPECT_EQ(actual.nan_count, 5U * expected.nan_count);
+	EXPECT_EQ(actual.zero_count, 5U * expected.zero_count);
+	EXPECT_EQ(actual.subnormal_count, 5U * expected.subnormal_count);
+}
+
+
+GTEST_TEST(bfloat16_bulk, FindFirstReturnsIndexOfFirstMatchingElement)
+{
+	std::vector<bfloat16_t> values(100, bfloat16_t{ 1.0f });
+
+	EXPECT_EQ(biovault::find_first_non_finite(values.data(), values.size()), values.size());
+	EXPECT_EQ(biovault::find_first(values.data(), values.size(), bfloat16_category::normal), 0U);
+
+	for (const std::size_t index : { 99U, 42U, 17U, 8U, 3U, 0U })
+	{
+		values[index] = bfloat16_t{ float_limits::quiet_NaN() };
+		EXPECT_EQ(biovault::find_first_nan(values.data(), values.size()), index);
+		EXPECT_EQ(biovault::find_first_non_finite(values.data(), values.size()), index);
+		EXPECT_EQ(biovault::kernels::scalar::find_first(values.data(), values.size(), bfloat16_category::nan), index);
+		EXPECT_EQ(biovault::find_first_infinity(values.data(), values.size()), values.size());
+	}
+
+	values[50] = bfloat16_t{ -float_limits::infinity() };
+	values[60] = bfloat16_t{ 0.0f };
+	EXPECT_EQ(biovault::find_first_infinity(values.data(), values.size()), 50U);
+	EXPECT_EQ(biovault::find_first(values.data(), values.size(), bfloat16_category::positive_infinity), values.size());
+	EXPECT_EQ(biovault::find_first_zero(values.data(), values.size()), 60U);
+
+	const auto indices = biovault::find_all(values.data(), values.size(), bfloat16_category::non_finite);
+	EXPECT_EQ(indices, (std::vector<std::size_t>{ 0, 3, 8, 17, 42, 50, 99 }));
+}
+
+
+GTEST_TEST(bfloat16_bulk, ReplaceNonFiniteReplacesNanAndInfinityOnly)
+{
+	auto values = all_bfloat16_values();
+	const auto original_values = values;
+	const bfloat16_t replacement{ -1.0f };
+
+	EXPECT_EQ(biovault::replace_non_finite(values.data(), values.size(), replacement), 2U * 128U);
+
+	for (std::size_t i{}; i < values.size(); ++i)
+	{
+		const float original{ original_values[i] };
+
+		ASSERT_EQ(get_raw_bits(values[i]),
+			std::isfinite(original) ? get_raw_bits(original_values[i]) : get_raw_bits(replacement));
+	}
+
+	auto scalar_values = original_values;
+	EXPECT_EQ(biovault::kernels::scalar::replace_non_finite(scalar_values.data(), scalar_values.size(), replacement), 2U * 128U);
+}
+
+
+GTEST_TEST(bfloat16_bulk, FusedConversionEqualsConversionFollowedByScan)
+{
+	const auto floats = mixed_floats();
+	std::vector<bfloat16_t> expected(floats.size());
+	std::vector<bfloat16_t> actual(floats.size());
+
+	biovault::convert_float_to_bfloat16(floats.data(), expected.data(), floats.size());
+
+	expect_equal_classification(
+		biovault::convert_float_to_bfloat16_and_classify(floats.data(), actual.data(), floats.size()),
+		classify_by_fpclassify(expected));
+	EXPECT_EQ(std::memcmp(actual.data(), expected.data(), expected.size() * sizeof(bfloat16_t)), 0);
+
+	const bfloat16_t replacement{ 0.0f };
+	const auto expected_count = biovault::replace_non_finite(expected.data(), expected.size(), replacement);
+
+	EXPECT_GT(expected_count, 0U);
+	EXPECT_EQ(biovault::convert_float_to_bfloat16_replacing_non_finite(floats.data(), actual.data(), floats.size(), replacement),
+		expected_count);
+	EXPECT_EQ(std::memcmp(actual.data(), expected.data(), expected.size() * sizeof(bfloat16_t)), 0);
+	EXPECT_EQ(biovault::find_first_non_finite(actual.data(), actual.size()), actual.size());
+}
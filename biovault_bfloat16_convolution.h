@@ -0,0 +1,448 @@
+#ifndef BIOVAULT_BFLOAT16_CONVOLUTION_H_INCLUDE_GUARD
+#define BIOVAULT_BFLOAT16_CONVOLUTION_H_INCLUDE_GUARD
+
+/*******************************************************************************
+* Copyright 2020 LKEB, Leiden University Medical Center
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*******************************************************************************/
+
+// Separable convolution of 1-D signals, 2-D images, and 3-D volumes of
+// bfloat16_t (or float) elements, and the 2x downsampling of image pyramids.
+//
+// The data are processed tile by tile. Each tile of the input (including the
+// margin required by the kernels) is widened to float, filtered along x, y,
+// and z in small per-thread float buffers, and written as bfloat16_t (or
+// float). So no float copy of the whole image or volume is ever made. The
+// tiles are distributed over multiple threads.
+//
+// Images are stored row by row (x varying fastest), and volumes slice by
+// slice. Kernels must have an odd number of elements; the center element is
+// applied to the sample at the same position. Invalid arguments are reported
+// by throwing std::invalid_argument. The input and the output must not overlap
+// (filtering in place is not supported).
+
+#include "biovault_bfloat16.h"
+#include "biovault_bfloat16_bulk.h"
+#include "biovault_bfloat16_parallel.h"
+
+#include <algorithm> // For fill, max, and min.
+#include <array>
+#include <cmath>     // For ceil and exp.
+#include <cstddef>   // For size_t and ptrdiff_t.
+#include <cstring>   // For memcpy.
+#include <stdexcept> // For invalid_argument.
+#include <vector>
+
+namespace biovault {
+
+	// Specifies the values of the samples beyond the borders of the data.
+	enum class boundary_mode {
+		// Repeats the sample at the border: a a a | a b c d | d d d
+		replicate,
+
+		// Mirrors the data at the border sample: d c b | a b c d | c b a
+		reflect,
+
+		// Assumes zero beyond the border: 0 0 0 | a b c d | 0 0 0
+		zero
+	};
+
+	namespace convolution_detail {
+
+		// Output tile sizes. For a 2-D image, the float buffers of a tile (including
+		// its margin) take less than 100 KB for kernel radii up to eight, so they
+		// fit in the L2 cache. For a 3-D volume, the margin along y and z dominates:
+		// the buffers take about 0.8 MB for a radius of two, and 2 MB for a radius
+		// of eight, more than a typical L2 cache, so that the y and z passes may
+		// then run from the L3 cache.
+		constexpr std::size_t tile_width{ 256 };
+		constexpr std::size_t tile_height{ 32 };
+		constexpr std::size_t tile_depth{ 8 };
+
+		// The parameters of the filtering along one axis.
+		struct axis {
+			const float* kernel;
+			std::size_t radius;
+			std::size_t step;
+			std::size_t input_size;
+			std::size_t output_size;
+		};
+
+		inline axis make_axis(const std::vector<float>& kernel, const std::size_t step, const std::size_t input_size) {
+			if (kernel.size() % 2 == 0) {
+				throw std::invalid_argument("convolution: the kernel size must be odd");
+			}
+			return axis{ kernel.data(), kernel.size() / 2, step, input_size, (input_size + step - 1) / step };
+		}
+
+		// Maps the specified index (possibly beyond the borders) to an index in
+		// [0, size), or returns -1 when the sample is zero.
+		inline std::ptrdiff_t map_index(std::ptrdiff_t index, const std::size_t size, const boundary_mode mode) {
+			const auto signed_size = static_cast<std::ptrdiff_t>(size);
+
+			if ((index >= 0) && (index < signed_size)) {
+				return index;
+			}
+			switch (mode) {
+			case boundary_mode::replicate:
+				return (index < 0) ? 0 : (signed_size - 1);
+			case boundary_mode::reflect: {
+				if (size == 1) {
+					return 0;
+				}
+				const auto period = 2 * (signed_size - 1);
+				index = ((index < 0) ? -index : index) % period;
+				return (index < signed_size) ? index : (period - index);
+			}
+			default:
+				return -1;
+			}
+		}
+
+		// dst[0, size) = the sum of weights[k] * rows[k][0, size), for k in [0, count).
+		// Keeps four vectors of sums in registers, rather than writing a partial
+		// sum to memory for each weight.
+		inline void weighted_sum(const float* const* const rows, const float* const weights, const std::size_t count,
+			float* const dst, const std::size_t size) {
+			std::size_t i{};
+#if defined(BIOVAULT_BFLOAT16_HAS_AVX2)
+			for (; i + 32 <= size; i += 32) {
+				__m256 sums0 = _mm256_setzero_ps();
+				__m256 sums1 = _mm256_setzero_ps();
+				__m256 sums2 = _mm256_setzero_ps();
+				__m256 sums3 = _mm256_setzero_ps();
+
+				for (std::size_t k{}; k < count; ++k) {
+					const __m256 weight = _mm256_set1_ps(weights[k]);
+					const float* const row = rows[k] + i;
+					sums0 = _mm256_add_ps(sums0, _mm256_mul_ps(weight, _mm256_loadu_ps(row)));
+					sums1 = _mm256_add_ps(sums1, _mm256_mul_ps(weight, _mm256_loadu_ps(row + 8)));
+					sums2 = _mm256_add_ps(sums2, _mm256_mul_ps(weight, _mm256_loadu_ps(row + 16)));
+					sums3 = _mm256_add_ps(sums3, _mm256_mul_ps(weight, _mm256_loadu_ps(row + 24)));
+				}
+				_mm256_storeu_ps(dst + i, sums0);
+				_mm256_storeu_ps(dst + i + 8, sums1);
+				_mm256_storeu_ps(dst + i + 16, sums2);
+				_mm256_storeu_ps(dst + i + 24, sums3);
+			}
+#elif defined(BIOVAULT_BFLOAT16_HAS_SSE2)
+			for (; i + 16 <= size; i += 16) {
+				__m128 sums0 = _mm_setzero_ps();
+				__m128 sums1 = _mm_setzero_ps();
+				__m128 sums2 = _mm_setzero_ps();
+				__m128 sums3 = _mm_setzero_ps();
+
+				for (std::size_t k{}; k < count; ++k) {
+					const __m128 weight = _mm_set1_ps(weights[k]);
+					const float* const row = rows[k] + i;
+					sums0 = _mm_add_ps(sums0, _mm_mul_ps(weight, _mm_loadu_ps(row)));
+					sums1 = _mm_add_ps(sums1, _mm_mul_ps(weight, _mm_loadu_ps(row + 4)));
+					sums2 = _mm_add_ps(sums2, _mm_mul_ps(weight, _mm_loadu_ps(row + 8)));
+					sums3 = _mm_add_ps(sums3, _mm_mul_ps(weight, _mm_loadu_ps(row + 12)));
+				}
+				_mm_storeu_ps(dst + i, sums0);
+				_mm_storeu_ps(dst + i + 4, sums1);
+				_mm_storeu_ps(dst + i + 8, sums2);
+				_mm_storeu_ps(dst + i + 12, sums3);
+			}
+#endif
+			for (; i < size; ++i) {
+				float sum{};
+
+				for (std::size_t k{}; k < count; ++k) {
+					sum += weights[k] * rows[k][i];
+				}
+				dst[i] = sum;
+			}
+		}
+
+		inline void widen(const bfloat16_t* const src, float* const dst, const std::size_t size) {
+			kernels::native::convert_bfloat16_to_float(src, dst, size);
+		}
+
+		inline void widen(const float* const src, float* const dst, const std::size_t size) {
+			std::memcpy(dst, src, size * sizeof(float));
+		}
+
+		inline void narrow(const float* const src, bfloat16_t* const dst, const std::size_t size) {
+			kernels::native::convert_float_to_bfloat16(src, dst, size);
+		}
+
+		inline void narrow(const float* const src, float* const dst, const std::size_t size) {
+			std::memcpy(dst, src, size * sizeof(float));
+		}
+
+		// Widens the elements [begin, begin + count) of a row to float, where
+		// 'begin' may be negative, and begin + count may exceed the row size.
+		template <typename T>
+		void load_row(const T* const row, const std::size_t size, const std::ptrdiff_t begin, const std::size_t count,
+			float* const dst, const boundary_mode mode) {
+			const auto signed_size = static_cast<std::ptrdiff_t>(size);
+			const auto end = begin + static_cast<std::ptrdiff_t>(count);
+			const auto inner_begin = std::min(std::max<std::ptrdiff_t>(begin, 0), signed_size);
+			const auto inner_end = std::max(std::min(end, signed_size), inner_begin);
+
+			widen(row + inner_begin, dst + (inner_begin - begin), static_cast<std::size_t>(inner_end - inner_begin));
+
+			for (auto index = begin; index < end; ++index) {
+				if ((index < inner_begin) || (index >= inner_end)) {
+					const auto mapped_index = map_index(index, size, mode);
+					dst[index - begin] = (mapped_index < 0) ? 0.0f : float{ row[mapped_index] };
+				}
+				else {
+					// Skip the part that is already widened.
+					index = inner_end - 1;
+				}
+			}
+		}
+
+		// The float buffers of a thread, reused for all of its tiles.
+		struct tile_buffers {
+			std::vector<float> row;
+			std::vector<float> phases;
+			std::vector<float> filtered_x;
+			std::vector<float> filtered_xy;
+			std::vector<float> filtered_xyz;
+			std::vector<const float*> rows;
+		};
+
+		// Filters a tile of the input along all three axes, and stores the output
+		// elements [begin[i], end[i]) along each axis i.
+		template <typename InputType, typename OutputType>
+		void filter_tile(const InputType* const src, OutputType* const dst, const std::array<axis, 3>& axes, const boundary_mode mode,
+			const std::array<std::size_t, 3>& begin, const std::array<std::size_t, 3>& end, tile_buffers& buffers) {
+			const auto& x_axis = axes[0];
+			const auto& y_axis = axes[1];
+			const auto& z_axis = axes[2];
+
+			// The input range along each axis, including the margin for the kernel.
+			std::array<std::ptrdiff_t, 3> input_begin;
+			std::array<std::size_t, 3> input_count;
+
+			for (std::size_t i{}; i < 3; ++i) {
+				input_begin[i] = static_cast<std::ptrdiff_t>(begin[i] * axes[i].step) - static_cast<std::ptrdiff_t>(axes[i].radius);
+				input_count[i] = (end[i] - begin[i] - 1) * axes[i].step + 2 * axes[i].radius + 1;
+			}
+			const auto width = end[0] - begin[0];
+			const auto height = end[1] - begin[1];
+			const auto depth = end[2] - begin[2];
+
+			buffers.row.resize(input_count[0]);
+			buffers.phases.resize(input_count[0] + x_axis.step);
+			buffers.filtered_x.resize(input_count[2] * input_count[1] * width);
+			buffers.filtered_xy.resize(input_count[2] * height * width);
+			buffers.filtered_xyz.resize(width);
+			buffers.rows.resize(2 * std::max(std::max(x_axis.radius, y_axis.radius), z_axis.radius) + 1);
+
+			// Along x. With a step s, the row is split into s phases (every s-th
+			// sample), so that each kernel element is applied to contiguous samples.
+			const auto phase_size = (input_count[0] + x_axis.step - 1) / x_axis.step;
+
+			for (std::size_t z{}; z < input_count[2]; ++z) {
+				const auto input_z = map_index(input_begin[2] + static_cast<std::ptrdiff_t>(z), z_axis.input_size, mode);
+
+				for (std::size_t y{}; y < input_count[1]; ++y) {
+					const auto input_y = map_index(input_begin[1] + static_cast<std::ptrdiff_t>(y), y_axis.input_size, mode);
+
+					float* const filtered_row = buffers.filtered_x.data() + (z * input_count[1] + y) * width;
+
+					if ((input_z < 0) || (input_y < 0)) {
+						std::fill(filtered_row, filtered_row + width, 0.0f);
+						continue;
+					}
+					const auto row_index = static_cast<std::size_t>(input_z) * y_axis.input_size + static_cast<std::size_t>(input_y);
+					load_row(src + row_index * x_axis.input_size, x_axis.input_size, input_begin[0], input_count[0], buffers.row.data(), mode);
+
+					const float* samples = buffers.row.data();
+
+					if (x_axis.step > 1) {
+						for (std::size_t phase{}; phase < x_axis.step; ++phase) {
+							float* const phase_samples = buffers.phases.data() + phase * phase_size;
+
+							for (std::size_t i{ phase }, j{}; i < input_count[0]; i += x_axis.step, ++j) {
+								phase_samples[j] = buffers.row[i];
+							}
+						}
+						samples = buffers.phases.data();
+					}
+					for (std::size_t k{}; k <= 2 * x_axis.radius; ++k) {
+						buffers.rows[k] = samples + (k % x_axis.step) * phase_size + k / x_axis.step;
+					}
+					weighted_sum(buffers.rows.data(), x_axis.kernel, 2 * x_axis.radius + 1, filtered_row, width);
+				}
+			}
+
+			// Along y.
+			for (std::size_t z{}; z < input_count[2]; ++z) {
+				for (std::size_t y{}; y < height; ++y) {
+					for (std::size_t k{}; k <= 2 * y_axis.radius; ++k) {
+						buffers.rows[k] = buffers.filtered_x.data() + (z * input_count[1] + y * y_axis.step + k) * width;
+					}
+					weighted_sum(buffers.rows.data(), y_axis.kernel, 2 * y_axis.radius + 1,
+						buffers.filtered_xy.data() + (z * height + y) * width, width);
+				}
+			}
+
+			// Along z, and store.
+			for (std::size_t z{}; z < depth; ++z) {
+				for (std::size_t y{}; y < height; ++y) {
+					for (std::size_t k{}; k <= 2 * z_axis.radius; ++k) {
+						buffers.rows[k] = buffers.filtered_xy.data() + ((z * z_axis.step + k) * height + y) * width;
+					}
+					weighted_sum(buffers.rows.data(), z_axis.kernel, 2 * z_axis.radius + 1, buffers.filtered_xyz.data(), width);
+
+					const auto output_row_index = (begin[2] + z) * y_axis.output_size + begin[1] + y;
+					narrow(buffers.filtered_xyz.data(), dst + output_row_index * x_axis.output_size + begin[0], width);
+				}
+			}
+		}
+
+		// Filters the whole volume, distributing its tiles over the threads. The
+		// source and the destination must not overlap, as the tiles read the
+		// source (including their margins) after other tiles have been stored.
+		template <typename InputType, typename OutputType>
+		void filter(const InputType* const src, OutputType* const dst, const std::array<axis, 3>& axes, const boundary_mode mode,
+			const unsigned thread_count) {
+			const std::array<std::size_t, 3> tile_size{ { tile_width, tile_height, tile_depth } };
+			std::array<std::size_t, 3> tile_count;
+
+			for (std::size_t i{}; i < 3; ++i) {
+				tile_count[i] = (axes[i].output_size + tile_size[i] - 1) / tile_size[i];
+			}
+			parallel_for_ranges(tile_count[0] * tile_count[1] * tile_count[2], thread_count,
+				[&](const std::size_t tile_begin, const std::size_t tile_end, std::size_t) {
+				tile_buffers buffers;
+
+				for (auto tile = tile_begin; tile < tile_end; ++tile) {
+					const std::array<std::size_t, 3> tile_position{ {
+						tile % tile_count[0], (tile / tile_count[0]) % tile_count[1], tile / (tile_count[0] * tile_count[1]) } };
+					std::array<std::size_t, 3> begin;
+					std::array<std::size_t, 3> end;
+
+					for (std::size_t i{}; i < 3; ++i) {
+						begin[i] = tile_position[i] * tile_size[i];
+						end[i] = std::min(begin[i] + tile_size[i], axes[i].output_size);
+					}
+					filter_tile(src, dst, axes, mode, begin, end, buffers);
+				}
+			});
+		}
+
+		// The 5-tap binomial kernel of Burt and Adelson, for the pyramid reduction.
+		inline const std::vector<float>& pyramid_kernel() {
+			static const std::vector<float> kernel{ 1.0f / 16, 4.0f / 16, 6.0f / 16, 4.0f / 16, 1.0f / 16 };
+			return kernel;
+		}
+
+		inline const std::vector<float>& identity_kernel() {
+			static const std::vector<float> kernel{ 1.0f };
+			return kernel;
+		}
+	}
+
+
+	// Returns a normalized Gaussian kernel with the specified standard deviation
+	// (in samples), of 2 * radius + 1 elements. A radius of zero selects
+	// ceil(3 * sigma). Throws std::invalid_argument when sigma is not positive.
+	inline std::vector<float> gaussian_kernel(const float sigma, std::size_t radius = 0)
+	{
+		if (!(sigma > 0.0f)) {
+			throw std::invalid_argument("gaussian_kernel: sigma must be positive");
+		}
+		if (radius == 0) {
+			radius = static_cast<std::size_t>(std::ceil(3.0f * sigma));
+		}
+		std::vector<double> weights(2 * radius + 1);
+		double sum{};
+
+		for (std::size_t i{}; i < weights.size(); ++i) {
+			const auto distance = static_cast<double>(i) - static_cast<double>(radius);
+			weights[i] = std::exp(-0.5 * distance * distance / (double{ sigma } * sigma));
+			sum += weights[i];
+		}
+		std::vector<float> kernel(weights.size());
+
+		for (std::size_t i{}; i < weights.size(); ++i) {
+			kernel[i] = static_cast<float>(weights[i] / sum);
+		}
+		return kernel;
+	}
+
+	// Convolves a signal of 'size' elements with the specified kernel. The input
+	// and output elements may each be bfloat16_t or float.
+	template <typename InputType, typename OutputType>
+	void convolve_1d(const InputType* const src, OutputType* const dst, const std::size_t size,
+		const std::vector<float>& kernel, const boundary_mode mode = boundary_mode::replicate, const unsigned thread_count = 0)
+	{
+		using namespace convolution_detail;
+		filter(src, dst, { { make_axis(kernel, 1, size), make_axis(identity_kernel(), 1, 1), make_axis(identity_kernel(), 1, 1) } },
+			mode, thread_count);
+	}
+
+	// Convolves a width x height image with kernel_x along the rows, and with
+	// kernel_y along the columns.
+	template <typename InputType, typename OutputType>
+	void convolve_separable_2d(const InputType* const src, OutputType* const dst, const std::size_t width, const std::size_t height,
+		const std::vector<float>& kernel_x, const std::vector<float>& kernel_y,
+		const boundary_mode mode = boundary_mode::replicate, const unsigned thread_count = 0)
+	{
+		using namespace convolution_detail;
+		filter(src, dst, { { make_axis(kernel_x, 1, width), make_axis(kernel_y, 1, height), make_axis(identity_kernel(), 1, 1) } },
+			mode, thread_count);
+	}
+
+	// Convolves a width x height x depth volume with a kernel along each axis.
+	template <typename InputType, typename OutputType>
+	void convolve_separable_3d(const InputType* const src, OutputType* const dst,
+		const std::size_t width, const std::size_t height, const std::size_t depth,
+		const std::vector<float>& kernel_x, const std::vector<float>& kernel_y, const std::vector<float>& kernel_z,
+		const boundary_mode mode = boundary_mode::replicate, const unsigned thread_count = 0)
+	{
+		using namespace convolution_detail;
+		filter(src, dst, { { make_axis(kernel_x, 1, width), make_axis(kernel_y, 1, height), make_axis(kernel_z, 1, depth) } },
+			mode, thread_count);
+	}
+
+	// Returns the size of the next pyramid level, along one axis.
+	inline std::size_t downsampled_size(const std::size_t size)
+	{
+		return (size + 1) / 2;
+	}
+
+	// Reduces a width x height image to the next level of a Gaussian pyramid:
+	// smooths it by the 5-tap binomial kernel [1 4 6 4 1] / 16, and keeps the
+	// samples at even positions. The output has downsampled_size(width) x
+	// downsampled_size(height) elements. Only the kept samples are computed.
+	template <typename InputType, typename OutputType>
+	void downsample_2x_2d(const InputType* const src, OutputType* const dst, const std::size_t width, const std::size_t height,
+		const boundary_mode mode = boundary_mode::reflect, const unsigned thread_count = 0)
+	{
+		using namespace convolution_detail;
+		filter(src, dst, { { make_axis(pyramid_kernel(), 2, width), make_axis(pyramid_kernel(), 2, height), make_axis(identity_kernel(), 1, 1) } },
+			mode, thread_count);
+	}
+
+	// Reduces a width x height x depth volume to the next pyramid level, along all three axes.
+	template <typename InputType, typename OutputType>
+	void downsample_2x_3d(const InputType* const src, OutputType* const dst,
+		const std::size_t width, const std::size_t height, const std::size_t depth,
+		const boundary_mode mode = boundary_mode::reflect, const unsigned thread_count = 0)
+	{
+		using namespace convolution_detail;
+		filter(src, dst, { { make_axis(pyramid_kernel(), 2, width), make_axis(pyramid_kernel(), 2, height), make_axis(pyramid_kernel(), 2, depth) } },
+			mode, thread_count);
+	}
+}
+
+#endif
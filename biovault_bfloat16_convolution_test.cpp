@@ -0,0 +1,331 @@
+/*******************************************************************************
+* Copyright 2020 LKEB, Leiden University Medical Center
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*******************************************************************************/
+
+// The file to be tested. Included twice here, to check its include guards!
+#include "biovault_bfloat16_convolution.h"
+#include "biovault_bfloat16_convolution.h"
+
+// GoogleTest header file:
+#include <gtest/gtest.h>
+
+// Standard library header files:
+#include <array>
+#include <cmath>   // For fabs.
+#include <cstddef>
+#include <numeric> // For accumulate.
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+
+namespace
+{
+	using biovault::bfloat16_t;
+	using biovault::boundary_mode;
+
+	constexpr boundary_mode all_boundary_modes[] = { boundary_mode::replicate, boundary_mode::reflect, boundary_mode::zero };
+
+
+	std::vector<bfloat16_t> make_random_volume(const std::size_t size)
+	{
+		std::mt19937 generator;
+		std::uniform_real_distribution<float> distribution(-4.0f, 4.0f);
+		std::vector<bfloat16_t> result;
+		result.reserve(size);
+
+		for (std::size_t i{}; i < size; ++i)
+		{
+			result.emplace_back(distribution(generator));
+		}
+		return result;
+	}
+
+
+	// Returns the sample at the specified (possibly out-of-range) index, along
+	// one axis, as specified by the boundary mode, straight from its definition.
+	double sample(const std::vector<double>& line, std::ptrdiff_t index, const boundary_mode mode)
+	{
+		const auto size = static_cast<std::ptrdiff_t>(line.size());
+
+		while ((index < 0) || (index >= size))
+		{
+			if (mode == boundary_mode::zero)
+			{
+				return 0.0;
+			}
+			if (mode == boundary_mode::replicate)
+			{
+				index = (index < 0) ? 0 : (size - 1);
+			}
+			else
+			{
+				index = (size == 1) ? 0 : ((index < 0) ? -index : (2 * (size - 1) - index));
+			}
+		}
+		return line[static_cast<std::size_t>(index)];
+	}
+
+
+	// Straightforward reference implementation: filters a line along one axis, in double precision.
+	std::vector<double> filter_line(const std::vector<double>& line, const std::vector<float>& kernel, const std::size_t step,
+		const boundary_mode mode)
+	{
+		const auto radius = static_cast<std::ptrdiff_t>(kernel.size() / 2);
+		std::vector<double> result((line.size() + step - 1) / step);
+
+		for (std::size_t i{}; i < result.size(); ++i)
+		{
+			for (std::ptrdiff_t k{ -radius }; k <= radius; ++k)
+			{
+				result[i] += double{ kernel[static_cast<std::size_t>(k + radius)] } *
+					sample(line, static_cast<std::ptrdiff_t>(i * step) + k, mode);
+			}
+		}
+		return result;
+	}
+
+
+	// Reference implementation of the separable filter of a volume, axis by axis.
+	std::vector<double> filter_volume(const std::vector<bfloat16_t>& volume, std::array<std::size_t, 3> size,
+		const std::array<std::vector<float>, 3>& kernels, const std::size_t step, const boundary_mode mode)
+	{
+		std::vector<double> data(volume.begin(), volume.end());
+
+		for (std::size_t axis{}; axis < 3; ++axis)
+		{
+			auto output_size = size;
+			output_size[axis] = (size[axis] + step - 1) / step;
+			std::vector<double> output(output_size[0] * output_size[1] * output_size[2]);
+
+			const std::size_t stride[] = { 1, size[0], size[0] * size[1] };
+			const std::size_t output_stride[] = { 1, output_size[0], output_size[0] * output_size[1] };
+
+			for (std::size_t z{}; z < output_size[2]; ++z)
+			{
+				for (std::size_t y{}; y < output_size[1]; ++y)
+				{
+					for (std::size_t x{}; x < output_size[0]; ++x)
+					{
+						const std::size_t position[] = { x, y, z };
+
+						if (position[axis] != 0)
+						{
+							continue;
+						}
+						std::size_t first{};
+
+						for (std::size_t i{}; i < 3; ++i)
+						{
+							first += position[i] * stride[i];
+						}
+						std::vector<double> line(size[axis]);
+
+						for (std::size_t i{}; i < line.size(); ++i)
+						{
+							line[i] = data[first + i * stride[axis]];
+						}
+						const auto filtered_line = filter_line(line, kernels[axis], (kernels[axis].size() > 1) ? step : 1, mode);
+						std::size_t output_first{};
+
+						for (std::size_t i{}; i < 3; ++i)
+						{
+							output_first += position[i] * output_stride[i];
+						}
+						for (std::size_t i{}; i < filtered_line.size(); ++i)
+						{
+							output[output_first + i * output_stride[axis]] = filtered_line[i];
+						}
+					}
+				}
+			}
+			data = output;
+			size = output_size;
+		}
+		return data;
+	}
+
+
+	void expect_near(const std::vector<float>& actual, const std::vector<double>& expected)
+	{
+		ASSERT_EQ(actual.size(), expected.size());
+
+		for (std::size_t i{}; i < actual.size(); ++i)
+		{
+			ASSERT_NEAR(actual[i], expected[i], 1e-4) << "i = " << i;
+		}
+	}
+
+
+	void expect_near(const std::vector<bfloat16_t>& actual, const std::vector<double>& expected)
+	{
+		ASSERT_EQ(actual.size(), expected.size());
+
+		for (std::size_t i{}; i < actual.size(); ++i)
+		{
+			// Half a unit in the last place of bfloat16, plus a little for the float accumulation.
+			ASSERT_NEAR(actual[i], expected[i], std::fabs(expected[i]) / 256.0 + 1e-4) << "i = " << i;
+		}
+	}
+
+}
+
+
+GTEST_TEST(bfloat16_convolution, GaussianKernelIsNormalizedAndSymmetric)
+{
+	const auto kernel = biovault::gaussian_kernel(1.5f);
+	ASSERT_EQ(kernel.size(), 11);
+	EXPECT_NEAR(std::accumulate(kernel.cbegin(), kernel.cend(), 0.0), 1.0, 1e-6);
+
+	for (std::size_t i{}; i < kernel.size(); ++i)
+	{
+		EXPECT_FLOAT_EQ(kernel[i], kernel[kernel.size() - 1 - i]);
+	}
+	EXPECT_EQ(biovault::gaussian_kernel(1.5f, 2).size(), 5);
+	EXPECT_THROW(biovault::gaussian_kernel(0.0f), std::invalid_argument);
+}
+
+
+GTEST_TEST(bfloat16_convolution, ThrowsOnEvenKernelSize)
+{
+	const auto signal = make_random_volume(10);
+	std::vector<float> result(signal.size());
+	EXPECT_THROW(biovault::convolve_1d(signal.data(), result.data(), signal.size(), { 0.5f, 0.5f }), std::invalid_argument);
+	EXPECT_THROW(biovault::convolve_1d(signal.data(), result.data(), signal.size(), {}), std::invalid_argument);
+}
+
+
+GTEST_TEST(bfloat16_convolution, Convolve1D)
+{
+	const std::vector<float> kernel{ 0.125f, -0.25f, 0.5f, 0.375f, 0.25f };
+
+	// Sizes smaller than the kernel, and larger than a tile.
+	for (const std::size_t size : { 1, 2, 3, 700 })
+	{
+		const auto signal = make_random_volume(size);
+
+		for (const auto mode : all_boundary_modes)
+		{
+			const auto expected = filter_volume(signal, { { size, 1, 1 } }, { { kernel, { 1.0f }, { 1.0f } } }, 1, mode);
+
+			std::vector<float> float_result(size);
+			biovault::convolve_1d(signal.data(), float_result.data(), size, kernel, mode);
+			expect_near(float_result, expected);
+
+			std::vector<bfloat16_t> bfloat16_result(size);
+			biovault::convolve_1d(signal.data(), bfloat16_result.data(), size, kernel, mode);
+			expect_near(bfloat16_result, expected);
+		}
+	}
+}
+
+
+GTEST_TEST(bfloat16_convolution, ConvolveSeparable2D)
+{
+	// Not a multiple of the tile size, in either direction.
+	constexpr std::size_t width{ 300 };
+	constexpr std::size_t height{ 70 };
+	const auto image = make_random_volume(width * height);
+	const auto kernel_x = biovault::gaussian_kernel(2.0f);
+	const std::vector<float> kernel_y{ 0.25f, 0.5f, 0.25f };
+
+	for (const auto mode : all_boundary_modes)
+	{
+		const auto expected = filter_volume(image, { { width, height, 1 } }, { { kernel_x, kernel_y, { 1.0f } } }, 1, mode);
+
+		for (const unsigned thread_count : { 1, 3 })
+		{
+			std::vector<bfloat16_t> result(image.size());
+			biovault::convolve_separable_2d(image.data(), result.data(), width, height, kernel_x, kernel_y, mode, thread_count);
+			expect_near(result, expected);
+		}
+	}
+}
+
+
+GTEST_TEST(bfloat16_convolution, ConvolveSeparable3D)
+{
+	constexpr std::size_t width{ 35 };
+	constexpr std::size_t height{ 40 };
+	constexpr std::size_t depth{ 20 };
+	const auto volume = make_random_volume(width * height * depth);
+	const std::vector<float> kernel_x{ 0.25f, 0.5f, 0.25f };
+	const auto kernel_y = biovault::gaussian_kernel(1.0f);
+	const auto kernel_z = biovault::gaussian_kernel(1.5f);
+
+	for (const auto mode : all_boundary_modes)
+	{
+		const auto expected = filter_volume(volume, { { width, height, depth } }, { { kernel_x, kernel_y, kernel_z } }, 1, mode);
+
+		std::vector<float> result(volume.size());
+		biovault::convolve_separable_3d(volume.data(), result.data(), width, height, depth, kernel_x, kernel_y, kernel_z, mode, 2);
+		expect_near(result, expected);
+	}
+}
+
+
+GTEST_TEST(bfloat16_convolution, Downsample2D)
+{
+	// Even and odd sizes.
+	for (const std::size_t width : { 1, 2, 5, 513 })
+	{
+		constexpr std::size_t height{ 67 };
+		const auto image = make_random_volume(width * height);
+		const auto& kernel = biovault::convolution_detail::pyramid_kernel();
+
+		for (const auto mode : all_boundary_modes)
+		{
+			const auto expected = filter_volume(image, { { width, height, 1 } }, { { kernel, kernel, { 1.0f } } }, 2, mode);
+
+			std::vector<bfloat16_t> result(biovault::downsampled_size(width) * biovault::downsampled_size(height));
+			biovault::downsample_2x_2d(image.data(), result.data(), width, height, mode);
+			expect_near(result, expected);
+		}
+	}
+}
+
+
+GTEST_TEST(bfloat16_convolution, Downsample3D)
+{
+	constexpr std::size_t width{ 33 };
+	constexpr std::size_t height{ 18 };
+	constexpr std::size_t depth{ 21 };
+	const auto volume = make_random_volume(width * height * depth);
+	const auto& kernel = biovault::convolution_detail::pyramid_kernel();
+	const auto expected = filter_volume(volume, { { width, height, depth } }, { { kernel, kernel, kernel } }, 2, boundary_mode::reflect);
+
+	std::vector<float> result(biovault::downsampled_size(width) * biovault::downsampled_size(height) * biovault::downsampled_size(depth));
+	biovault::downsample_2x_3d(volume.data(), result.data(), width, height, depth);
+	expect_near(result, expected);
+}
+
+
+GTEST_TEST(bfloat16_convolution, DownsamplePreservesConstantImage)
+{
+	constexpr std::size_t width{ 100 };
+	constexpr std::size_t height{ 50 };
+	const std::vector<bfloat16_t> image(width * height, bfloat16_t(3.0f));
+	std::vector<bfloat16_t> result(50 * 25);
+
+	for (const auto mode : { boundary_mode::replicate, boundary_mode::reflect })
+	{
+		biovault::downsample_2x_2d(image.data(), result.data(), width, height, mode);
+
+		for (const auto value : result)
+		{
+			EXPECT_FLOAT_EQ(value, 3.0f);
+		}
+	}
+}
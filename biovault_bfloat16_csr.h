@@ -0,0 +1,379 @@
+#ifndef BIOVAULT_BFLOAT16_CSR_H_INCLUDE_GUARD
+#define BIOVAULT_BFLOAT16_CSR_H_INCLUDE_GUARD
+
+/*******************************************************************************
+* Copyright 2020 LKEB, Leiden University Medical Center
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*******************************************************************************/
+
+// Sparse matrix in compressed sparse row (CSR) format, with bfloat16_t values
+// and 32-bit column indices (6 bytes per non-zero, instead of 8 for float
+// values), as used for kNN graphs and t-SNE affinity matrices.
+//
+// The multithreaded products with a dense vector (spmv) and with a dense
+// row-major matrix (spmm) widen the bfloat16 values to float in registers, and
+// accumulate in float. The dense operand may have either float or bfloat16_t
+// elements.
+
+#include "biovault_bfloat16.h"
+#include "biovault_bfloat16_bulk.h"
+#include "biovault_bfloat16_parallel.h"
+
+#include <algorithm> // For fill_n, is_sorted, lower_bound, and sort.
+#include <cmath>     // For fpclassify.
+#include <cstddef>   // For size_t.
+#include <cstdint>   // For uint32_t.
+#include <limits>
+#include <stdexcept> // For invalid_argument.
+#include <utility>   // For move and pair.
+#include <vector>
+
+namespace biovault {
+
+	class csr_matrix {
+	public:
+		using index_type = std::uint32_t;
+
+		csr_matrix() = default;
+
+		// Constructs a matrix from its CSR arrays. Throws std::invalid_argument when
+		// the arrays are inconsistent. The column indices within a row do not need to
+		// be sorted.
+		csr_matrix(const std::size_t row_count, const std::size_t column_count,
+			std::vector<std::size_t> row_offsets, std::vector<index_type> column_indices, std::vector<bfloat16_t> values)
+			:
+			row_count_(row_count),
+			column_count_(column_count),
+			row_offsets_(std::move(row_offsets)),
+			column_indices_(std::move(column_indices)),
+			values_(std::move(values))
+		{
+			validate();
+		}
+
+		// Constructs a matrix from CSR arrays with float values, which are
+		// converted to bfloat16.
+		csr_matrix(const std::size_t row_count, const std::size_t column_count,
+			std::vector<std::size_t> row_offsets, std::vector<index_type> column_indices, const std::vector<float>& values)
+			:
+			csr_matrix(row_count, column_count, std::move(row_offsets), std::move(column_indices), to_bfloat16(values))
+		{
+		}
+
+		std::size_t row_count() const { return row_count_; }
+		std::size_t column_count() const { return column_count_; }
+		std::size_t nonzero_count() const { return values_.size(); }
+
+		// Has row_count() + 1 elements: row i consists of the non-zeros from
+		// row_offsets()[i] to row_offsets()[i + 1].
+		const std::vector<std::size_t>& row_offsets() const { return row_offsets_; }
+		const std::vector<index_type>& column_indices() const { return column_indices_; }
+		const std::vector<bfloat16_t>& values() const { return values_; }
+
+		// Allows modifying the values in place (the sparsity pattern is fixed).
+		std::vector<bfloat16_t>& values() { return values_; }
+
+	private:
+		static std::vector<bfloat16_t> to_bfloat16(const std::vector<float>& values) {
+			std::vector<bfloat16_t> result(values.size());
+			parallel_convert_float_to_bfloat16(values.data(), result.data(), values.size());
+			return result;
+		}
+
+		void validate() const {
+			if (column_count_ > std::size_t{ std::numeric_limits<index_type>::max() } + 1) {
+				throw std::invalid_argument("csr_matrix: the column count exceeds the range of the column indices");
+			}
+			if ((row_offsets_.size() != row_count_ + 1) || (row_offsets_.front() != 0)) {
+				throw std::invalid_argument("csr_matrix: the row offsets should start at zero, and have row_count + 1 elements");
+			}
+			if ((row_offsets_.back() != values_.size()) || (column_indices_.size() != values_.size())) {
+				throw std::invalid_argument("csr_matrix: the number of column indices and values should equal the last row offset");
+			}
+			if (!std::is_sorted(row_offsets_.cbegin(), row_offsets_.cend())) {
+				throw std::invalid_argument("csr_matrix: the row offsets should be non-decreasing");
+			}
+			for (const auto column_index : column_indices_) {
+				if (column_index >= column_count_) {
+					throw std::invalid_argument("csr_matrix: a column index is out of range");
+				}
+			}
+		}
+
+		std::size_t row_count_{};
+		std::size_t column_count_{};
+		std::vector<std::size_t> row_offsets_{ 0 };
+		std::vector<index_type> column_indices_;
+		std::vector<bfloat16_t> values_;
+	};
+
+
+	namespace csr_detail {
+
+		inline float to_float(const float f) {
+			return f;
+		}
+
+		inline float to_float(const bfloat16_t bf16) {
+			return bf16;
+		}
+
+		// Minimum number of non-zeros per thread.
+		constexpr std::size_t min_nonzeros_per_thread{ std::size_t{ 1 } << 14U };
+
+		// Calls function(row_begin, row_end) for ranges of rows with roughly equal
+		// numbers of non-zeros, on multiple threads. Each row (including the empty
+		// rows at the end) is in exactly one range.
+		template <typename Function>
+		void parallel_for_rows(const csr_matrix& matrix, const unsigned thread_count, Function function) {
+			const auto& row_offsets = matrix.row_offsets();
+			const auto nonzero_count = matrix.nonzero_count();
+			const auto row_offsets_end = row_offsets.cbegin() + static_cast<std::ptrdiff_t>(matrix.row_count());
+
+			parallel_for_ranges(nonzero_count, thread_count, [&](const std::size_t begin, const std::size_t end, std::size_t) {
+				// A row belongs to the range that contains its first non-zero.
+				const auto row_begin = static_cast<std::size_t>(std::lower_bound(row_offsets.cbegin(), row_offsets_end, begin) - row_offsets.cbegin());
+				const auto row_end = (end == nonzero_count) ? matrix.row_count() :
+					static_cast<std::size_t>(std::lower_bound(row_offsets.cbegin(), row_offsets_end, end) - row_offsets.cbegin());
+				function(row_begin, row_end);
+			}, min_nonzeros_per_thread);
+		}
+
+		template <typename T>
+		float sparse_dot(const bfloat16_t* const values, const csr_matrix::index_type* const column_indices, const std::size_t size,
+			const T* const x) {
+			float sum{};
+
+			for (std::size_t i{}; i < size; ++i) {
+				sum += to_float(values[i]) * to_float(x[column_indices[i]]);
+			}
+			return sum;
+		}
+
+#ifdef BIOVAULT_BFLOAT16_HAS_AVX2
+		// Widens eight bfloat16 values to floats, in a register.
+		inline __m256 widen(const bfloat16_t* const values) {
+			return _mm256_castsi256_ps(_mm256_slli_epi32(
+				_mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(values))), 16));
+		}
+
+		// Gathers x[column_indices[i]]. Requires the column indices to be less than 2^31.
+		inline float sparse_dot(const bfloat16_t* const values, const csr_matrix::index_type* const column_indices, const std::size_t size,
+			const float* const x) {
+			__m256 sums = _mm256_setzero_ps();
+			std::size_t i{};
+
+			for (; i + 8 <= size; i += 8) {
+				const __m256i indices = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(column_indices + i));
+				const __m256 products = _mm256_mul_ps(widen(values + i), _mm256_i32gather_ps(x, indices, 4));
+				sums = _mm256_add_ps(sums, products);
+			}
+
+			const __m128 sums4 = _mm_add_ps(_mm256_castps256_ps128(sums), _mm256_extractf128_ps(sums, 1));
+			const __m128 sums2 = _mm_add_ps(sums4, _mm_movehl_ps(sums4, sums4));
+			const __m128 sum = _mm_add_ss(sums2, _mm_shuffle_ps(sums2, sums2, 1));
+			return _mm_cvtss_f32(sum) + sparse_dot<float>(values + i, column_indices + i, size - i, x);
+		}
+#endif
+
+		// y[0, size) += a * x[0, size)
+		inline void axpy(const float a, const float* const x, float* const y, const std::size_t size) {
+			for (std::size_t i{}; i < size; ++i) {
+				y[i] += a * x[i];
+			}
+		}
+
+		// y[0, size) += a * x[0, size), widening x to float in registers.
+		inline void axpy(const float a, const bfloat16_t* const x, float* const y, const std::size_t size) {
+			std::size_t i{};
+#ifdef BIOVAULT_BFLOAT16_HAS_SSE2
+			const __m128 a4 = _mm_set1_ps(a);
+
+			for (; i + 8 <= size; i += 8) {
+				const __m128i bits = _mm_loadu_si128(reinterpret_cast<const __m128i*>(x + i));
+				const __m128 low = _mm_castsi128_ps(_mm_unpacklo_epi16(_mm_setzero_si128(), bits));
+				const __m128 high = _mm_castsi128_ps(_mm_unpackhi_epi16(_mm_setzero_si128(), bits));
+				_mm_storeu_ps(y + i, _mm_add_ps(_mm_loadu_ps(y + i), _mm_mul_ps(a4, low)));
+				_mm_storeu_ps(y + i + 4, _mm_add_ps(_mm_loadu_ps(y + i + 4), _mm_mul_ps(a4, high)));
+			}
+#endif
+			for (; i < size; ++i) {
+				y[i] += a * float{ x[i] };
+			}
+		}
+
+		// Pairs of column index and value, of a row that is being assembled.
+		using row_entries = std::vector<std::pair<csr_matrix::index_type, float>>;
+	}
+
+
+	// Computes y = A x, where x has A.column_count() elements, and y has
+	// A.row_count() elements. The vector x may have float or bfloat16_t elements.
+	template <typename T>
+	void spmv(const csr_matrix& a, const T* const x, float* const y, const unsigned thread_count = 0)
+	{
+		const auto* const row_offsets = a.row_offsets().data();
+		const auto* const column_indices = a.column_indices().data();
+		const auto* const values = a.values().data();
+
+#ifdef BIOVAULT_BFLOAT16_HAS_AVX2
+		// The gather instruction takes signed 32-bit indices.
+		const bool can_gather{ a.column_count() <= std::size_t{ 1 } << 31U };
+#else
+		constexpr bool can_gather{ false };
+#endif
+
+		csr_detail::parallel_for_rows(a, thread_count, [=](const std::size_t row_begin, const std::size_t row_end) {
+			for (auto row = row_begin; row < row_end; ++row) {
+				const auto offset = row_offsets[row];
+				const auto size = row_offsets[row + 1] - offset;
+
+				y[row] = can_gather ?
+					csr_detail::sparse_dot(values + offset, column_indices + offset, size, x) :
+					csr_detail::sparse_dot<T>(values + offset, column_indices + offset, size, x);
+			}
+		});
+	}
+
+	// Computes C = A B, where B is a dense row-major matrix of A.column_count()
+	// rows and 'b_column_count' columns, and C is a dense row-major float matrix of
+	// A.row_count() rows and 'b_column_count' columns. The matrix B may have float
+	// or bfloat16_t elements.
+	template <typename T>
+	void spmm(const csr_matrix& a, const T* const b, const std::size_t b_column_count, float* const c, const unsigned thread_count = 0)
+	{
+		const auto* const row_offsets = a.row_offsets().data();
+		const auto* const column_indices = a.column_indices().data();
+		const auto* const values = a.values().data();
+
+		csr_detail::parallel_for_rows(a, thread_count, [=](const std::size_t row_begin, const std::size_t row_end) {
+			for (auto row = row_begin; row < row_end; ++row) {
+				float* const c_row = c + row * b_column_count;
+				std::fill_n(c_row, b_column_count, 0.0f);
+
+				for (auto k = row_offsets[row]; k < row_offsets[row + 1]; ++k) {
+					csr_detail::axpy(values[k], b + std::size_t{ column_indices[k] } * b_column_count, c_row, b_column_count);
+				}
+			}
+		});
+	}
+
+	// Returns the transpose of the specified matrix, with the column indices of
+	// each row sorted in ascending order.
+	inline csr_matrix transpose(const csr_matrix& a)
+	{
+		const auto& row_offsets = a.row_offsets();
+		const auto& column_indices = a.column_indices();
+		const auto& values = a.values();
+
+		// Counting sort by column index.
+		std::vector<std::size_t> transposed_offsets(a.column_count() + 1);
+
+		for (const auto column_index : column_indices) {
+			++transposed_offsets[std::size_t{ column_index } + 1];
+		}
+		for (std::size_t i{}; i < a.column_count(); ++i) {
+			transposed_offsets[i + 1] += transposed_offsets[i];
+		}
+
+		std::vector<csr_matrix::index_type> transposed_column_indices(a.nonzero_count());
+		std::vector<bfloat16_t> transposed_values(a.nonzero_count());
+		auto positions = transposed_offsets;
+
+		for (std::size_t row{}; row < a.row_count(); ++row) {
+			for (auto k = row_offsets[row]; k < row_offsets[row + 1]; ++k) {
+				const auto position = positions[column_indices[k]]++;
+				transposed_column_indices[position] = static_cast<csr_matrix::index_type>(row);
+				transposed_values[position] = values[k];
+			}
+		}
+		return csr_matrix(a.column_count(), a.row_count(), std::move(transposed_offsets),
+			std::move(transposed_column_indices), std::move(transposed_values));
+	}
+
+	// Returns scale * (A + A^T), computed in float, for a square matrix A. With
+	// the default scale of one half, this is the usual symmetrisation of kNN
+	// graphs and of t-SNE affinities (which may then be normalised by
+	// normalize_rows, or scaled by 1 / row_count). Entries of A and A^T at the
+	// same position are summed. The column indices of each row of the result
+	// are sorted in ascending order. Throws std::invalid_argument when A is not
+	// square.
+	inline csr_matrix symmetrize(const csr_matrix& a, const float scale = 0.5f)
+	{
+		if (a.row_count() != a.column_count()) {
+			throw std::invalid_argument("symmetrize: the matrix should be square");
+		}
+		const auto transposed = transpose(a);
+		std::vector<std::size_t> row_offsets{ 0 };
+		std::vector<csr_matrix::index_type> column_indices;
+		std::vector<float> values;
+		csr_detail::row_entries entries;
+
+		row_offsets.reserve(a.row_count() + 1);
+		column_indices.reserve(2 * a.nonzero_count());
+		values.reserve(2 * a.nonzero_count());
+
+		for (std::size_t row{}; row < a.row_count(); ++row) {
+			entries.clear();
+
+			for (const auto* matrix : { &a, &transposed }) {
+				for (auto k = matrix->row_offsets()[row]; k < matrix->row_offsets()[row + 1]; ++k) {
+					entries.emplace_back(matrix->column_indices()[k], matrix->values()[k]);
+				}
+			}
+			std::sort(entries.begin(), entries.end(), [](const csr_detail::row_entries::value_type& lhs, const csr_detail::row_entries::value_type& rhs) {
+				return lhs.first < rhs.first;
+			});
+
+			for (std::size_t i{}; i < entries.size(); ) {
+				const auto column_index = entries[i].first;
+				float sum{};
+
+				for (; (i < entries.size()) && (entries[i].first == column_index); ++i) {
+					sum += entries[i].second;
+				}
+				column_indices.push_back(column_index);
+				values.push_back(scale * sum);
+			}
+			row_offsets.push_back(values.size());
+		}
+		return csr_matrix(a.row_count(), a.column_count(), std::move(row_offsets), std::move(column_indices), values);
+	}
+
+	// Divides each row by the sum of its values (computed in float), in place, so
+	// that each row sums to one (up to bfloat16 rounding). Rows whose sum is zero
+	// are left unchanged.
+	inline void normalize_rows(csr_matrix& a, const unsigned thread_count = 0)
+	{
+		const auto* const row_offsets = a.row_offsets().data();
+		auto* const values = a.values().data();
+
+		csr_detail::parallel_for_rows(a, thread_count, [=](const std::size_t row_begin, const std::size_t row_end) {
+			for (auto row = row_begin; row < row_end; ++row) {
+				float sum{};
+
+				for (auto k = row_offsets[row]; k < row_offsets[row + 1]; ++k) {
+					sum += values[k];
+				}
+				if (std::fpclassify(sum) != FP_ZERO) {
+					for (auto k = row_offsets[row]; k < row_offsets[row + 1]; ++k) {
+						values[k] = bfloat16_t{ values[k] / sum };
+					}
+				}
+			}
+		});
+	}
+}
+
+#endif
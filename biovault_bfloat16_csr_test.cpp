@@ -0,0 +1,272 @@
+/*******************************************************************************
+* Copyright 2020 LKEB, Leiden University Medical Center
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*******************************************************************************/
+
+// The file to be tested. Included twice here, to check its include guards!
+#include "biovault_bfloat16_csr.h"
+#include "biovault_bfloat16_csr.h"
+
+// GoogleTest header file:
+#include <gtest/gtest.h>
+
+// Standard library header files:
+#include <algorithm> // For adjacent_find and is_sorted.
+#include <cstdint>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+
+namespace
+{
+	using biovault::bfloat16_t;
+	using biovault::csr_matrix;
+
+
+	// Returns a random matrix with (on average) 'nonzeros_per_row' non-zeros per
+	// row, whose values are exactly representable by bfloat16. Some rows are
+	// empty, including the last 'trailing_empty_row_count' rows. Optionally, the
+	// row in the middle has 'long_row_size' non-zeros.
+	csr_matrix make_random_matrix(const std::size_t row_count, const std::size_t column_count, const unsigned nonzeros_per_row,
+		const std::size_t trailing_empty_row_count = 1, const unsigned long_row_size = 0)
+	{
+		std::mt19937 generator;
+		std::uniform_int_distribution<unsigned> size_distribution(0, 2 * nonzeros_per_row);
+		std::uniform_int_distribution<csr_matrix::index_type> column_distribution(0, static_cast<csr_matrix::index_type>(column_count - 1));
+		std::uniform_int_distribution<int> value_distribution(1, 64);
+
+		std::vector<std::size_t> row_offsets{ 0 };
+		std::vector<csr_matrix::index_type> column_indices;
+		std::vector<float> values;
+
+		for (std::size_t row{}; row < row_count; ++row)
+		{
+			const auto size = ((row == row_count / 2) && (long_row_size > 0)) ? long_row_size :
+				((row % 7 == 3) || (row + trailing_empty_row_count >= row_count)) ? 0U : size_distribution(generator);
+
+			for (unsigned i{}; i < size; ++i)
+			{
+				column_indices.push_back(column_distribution(generator));
+				values.push_back(static_cast<float>(value_distribution(generator)) / 64.0f);
+			}
+			row_offsets.push_back(values.size());
+		}
+		return csr_matrix(row_count, column_count, row_offsets, column_indices, values);
+	}
+
+
+	std::vector<float> to_dense(const csr_matrix& matrix)
+	{
+		std::vector<float> result(matrix.row_count() * matrix.column_count());
+
+		for (std::size_t row{}; row < matrix.row_count(); ++row)
+		{
+			for (auto k = matrix.row_offsets()[row]; k < matrix.row_offsets()[row + 1]; ++k)
+			{
+				result[row * matrix.column_count() + matrix.column_indices()[k]] += matrix.values()[k];
+			}
+		}
+		return result;
+	}
+
+
+	// Computes C = A B by dense matrix multiplication, in double precision.
+	std::vector<float> dense_product(const std::vector<float>& a, const std::vector<float>& b,
+		const std::size_t row_count, const std::size_t inner_count, const std::size_t column_count)
+	{
+		std::vector<float> result(row_count * column_count);
+
+		for (std::size_t i{}; i < row_count; ++i)
+		{
+			for (std::size_t j{}; j < column_count; ++j)
+			{
+				double sum{};
+
+				for (std::size_t k{}; k < inner_count; ++k)
+				{
+					sum += double{ a[i * inner_count + k] } * double{ b[k * column_count + j] };
+				}
+				result[i * column_count + j] = static_cast<float>(sum);
+			}
+		}
+		return result;
+	}
+
+
+	std::vector<float> make_dense_values(const std::size_t size)
+	{
+		std::vector<float> result(size);
+
+		for (std::size_t i{}; i < size; ++i)
+		{
+			result[i] = static_cast<float>(static_cast<int>(i % 17) - 8) / 8.0f;
+		}
+		return result;
+	}
+
+
+	void expect_near(const std::vector<float>& actual, const std::vector<float>& expected)
+	{
+		ASSERT_EQ(actual.size(), expected.size());
+
+		for (std::size_t i{}; i < actual.size(); ++i)
+		{
+			EXPECT_NEAR(actual[i], expected[i], 1e-4f) << " at index " << i;
+		}
+	}
+}
+
+
+GTEST_TEST(bfloat16_csr, ConstructorThrowsOnInconsistentArrays)
+{
+	EXPECT_THROW(csr_matrix(2, 2, { 0, 1 }, { 0 }, std::vector<float>{ 1.0f }), std::invalid_argument);
+	EXPECT_THROW(csr_matrix(2, 2, { 0, 1, 2 }, { 0 }, std::vector<float>{ 1.0f }), std::invalid_argument);
+	EXPECT_THROW(csr_matrix(2, 2, { 0, 2, 1 }, { 0, 1 }, std::vector<float>{ 1.0f, 2.0f }), std::invalid_argument);
+	EXPECT_THROW(csr_matrix(2, 2, { 0, 1, 1 }, { 2 }, std::vector<float>{ 1.0f }), std::invalid_argument);
+
+	const csr_matrix matrix(2, 3, { 0, 2, 2 }, { 2, 0 }, std::vector<float>{ 1.5f, -2.0f });
+	EXPECT_EQ(matrix.row_count(), 2U);
+	EXPECT_EQ(matrix.column_count(), 3U);
+	EXPECT_EQ(matrix.nonzero_count(), 2U);
+	EXPECT_EQ(get_raw_bits(matrix.values()[0]), get_raw_bits(bfloat16_t{ 1.5f }));
+
+	const csr_matrix empty_matrix;
+	EXPECT_EQ(empty_matrix.row_offsets().size(), 1U);
+}
+
+
+GTEST_TEST(bfloat16_csr, SpmvEqualsDenseProduct)
+{
+	// Enough non-zeros for at least three ranges of rows, with a row that spans
+	// multiple ranges, and trailing empty rows.
+	constexpr std::size_t row_count{ 1000 };
+	constexpr std::size_t column_count{ 300 };
+	const auto a = make_random_matrix(row_count, column_count, 40, 5, 30000);
+	ASSERT_GE(a.nonzero_count(), 3 * biovault::csr_detail::min_nonzeros_per_thread);
+
+	const auto x = make_dense_values(column_count);
+	const auto expected = dense_product(to_dense(a), x, row_count, column_count, 1);
+
+	for (const unsigned thread_count : { 1U, 3U, 4U })
+	{
+		std::vector<float> y(row_count, -1.0f);
+		biovault::spmv(a, x.data(), y.data(), thread_count);
+		expect_near(y, expected);
+
+		// The elements of x are exactly representable by bfloat16.
+		std::vector<bfloat16_t> bfloat16_x(column_count);
+		biovault::convert_float_to_bfloat16(x.data(), bfloat16_x.data(), column_count);
+		std::vector<float> y_from_bfloat16(row_count, -1.0f);
+		biovault::spmv(a, bfloat16_x.data(), y_from_bfloat16.data(), thread_count);
+		expect_near(y_from_bfloat16, expected);
+	}
+}
+
+
+GTEST_TEST(bfloat16_csr, SpmmEqualsDenseProduct)
+{
+	constexpr std::size_t row_count{ 1000 };
+	constexpr std::size_t column_count{ 200 };
+	constexpr std::size_t b_column_count{ 13 };
+	const auto a = make_random_matrix(row_count, column_count, 30, 5, 30000);
+	ASSERT_GE(a.nonzero_count(), 3 * biovault::csr_detail::min_nonzeros_per_thread);
+
+	const auto b = make_dense_values(column_count * b_column_count);
+	const auto expected = dense_product(to_dense(a), b, row_count, column_count, b_column_count);
+
+	std::vector<float> c(row_count * b_column_count, -1.0f);
+	biovault::spmm(a, b.data(), b_column_count, c.data(), 3);
+	expect_near(c, expected);
+
+	std::vector<bfloat16_t> bfloat16_b(b.size());
+	biovault::convert_float_to_bfloat16(b.data(), bfloat16_b.data(), b.size());
+	std::vector<float> c_from_bfloat16(row_count * b_column_count, -1.0f);
+	biovault::spmm(a, bfloat16_b.data(), b_column_count, c_from_bfloat16.data(), 3);
+	expect_near(c_from_bfloat16, expected);
+}
+
+
+GTEST_TEST(bfloat16_csr, TransposeTransposesDenseEquivalent)
+{
+	const auto a = make_random_matrix(40, 30, 5);
+	const auto a_dense = to_dense(a);
+	const auto transposed = biovault::transpose(a);
+	const auto transposed_dense = to_dense(transposed);
+
+	ASSERT_EQ(transposed.row_count(), 30U);
+	ASSERT_EQ(transposed.column_count(), 40U);
+	EXPECT_EQ(transposed.nonzero_count(), a.nonzero_count());
+
+	for (std::size_t i{}; i < 40; ++i)
+	{
+		for (std::size_t j{}; j < 30; ++j)
+		{
+			EXPECT_FLOAT_EQ(transposed_dense[j * 40 + i], a_dense[i * 30 + j]);
+		}
+	}
+}
+
+
+GTEST_TEST(bfloat16_csr, SymmetrizeYieldsHalfOfSumWithTranspose)
+{
+	constexpr std::size_t size{ 60 };
+	const auto a = make_random_matrix(size, size, 6);
+	const auto a_dense = to_dense(a);
+	const auto symmetric = biovault::symmetrize(a);
+	const auto symmetric_dense = to_dense(symmetric);
+
+	for (std::size_t row{}; row < size; ++row)
+	{
+		const auto begin = symmetric.column_indices().cbegin() + static_cast<std::ptrdiff_t>(symmetric.row_offsets()[row]);
+		const auto end = symmetric.column_indices().cbegin() + static_cast<std::ptrdiff_t>(symmetric.row_offsets()[row + 1]);
+		EXPECT_TRUE(std::is_sorted(begin, end));
+		EXPECT_EQ(std::adjacent_find(begin, end), end);
+
+		for (std::size_t column{}; column < size; ++column)
+		{
+			const float expected{ bfloat16_t{ 0.5f * (a_dense[row * size + column] + a_dense[column * size + row]) } };
+			EXPECT_FLOAT_EQ(symmetric_dense[row * size + column], expected);
+			EXPECT_FLOAT_EQ(symmetric_dense[row * size + column], symmetric_dense[column * size + row]);
+		}
+	}
+
+	EXPECT_THROW(biovault::symmetrize(make_random_matrix(3, 4, 1)), std::invalid_argument);
+}
+
+
+GTEST_TEST(bfloat16_csr, NormalizeRowsYieldsRowSumsOfOne)
+{
+	auto a = make_random_matrix(2000, 100, 20);
+	biovault::normalize_rows(a, 4);
+
+	for (std::size_t row{}; row < a.row_count(); ++row)
+	{
+		float sum{};
+
+		for (auto k = a.row_offsets()[row]; k < a.row_offsets()[row + 1]; ++k)
+		{
+			sum += a.values()[k];
+		}
+		if (a.row_offsets()[row + 1] > a.row_offsets()[row])
+		{
+			// Each of the (at most 40) values has a relative rounding error of at most 2^-9.
+			EXPECT_NEAR(sum, 1.0f, 0.01f);
+		}
+		else
+		{
+			EXPECT_FLOAT_EQ(sum, 0.0f);
+		}
+	}
+}
@@ -0,0 +1,675 @@
+#ifndef BIOVAULT_BFLOAT16_IO_H_INCLUDE_GUARD
+#define BIOVAULT_BFLOAT16_IO_H_INCLUDE_GUARD
+
+/*******************************************************************************
+* Copyright 2020 LKEB, Leiden University Medical Center
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*******************************************************************************/
+
+// Serialization of bfloat16_t arrays to little-endian and big-endian byte
+// streams, and reading and writing of NumPy .npy files, interoperable with the
+// bfloat16 type of the Python ml_dtypes package (whose arrays are saved by
+// numpy.save with descr '<V2').
+//
+// The byte swapping has SSE2 and AVX2 kernels (in namespaces kernels::sse2 and
+// kernels::avx2). When the byte order of the stream matches the native byte
+// order, arrays are written and read without any intermediate copy, and
+// npy_mapped_file gives zero-copy access to a memory-mapped .npy file.
+//
+// Errors (I/O failures and unsupported .npy headers) are reported by throwing
+// std::runtime_error.
+
+#include "biovault_bfloat16.h"
+#include "biovault_bfloat16_bulk.h"
+
+#include <algorithm> // For find and min.
+#include <cstddef>   // For size_t.
+#include <cstdint>   // For uint8_t, uint16_t, and uint32_t.
+#include <cstring>   // For memcpy.
+#include <fstream>
+#include <istream>
+#include <limits>
+#include <ostream>
+#include <stdexcept> // For runtime_error.
+#include <string>
+#include <utility>   // For exchange and move.
+#include <vector>
+
+#ifdef _WIN32
+#	ifndef NOMINMAX
+#	define NOMINMAX
+#	endif
+#	ifndef WIN32_LEAN_AND_MEAN
+#	define WIN32_LEAN_AND_MEAN
+#	endif
+#include <windows.h>
+#else
+#include <fcntl.h>    // For open.
+#include <sys/mman.h> // For mmap and munmap.
+#include <sys/stat.h> // For fstat.
+#include <unistd.h>   // For close.
+#endif
+
+namespace biovault {
+
+	enum class byte_order {
+		little_endian,
+		big_endian
+	};
+
+	inline byte_order native_byte_order()
+	{
+		const std::uint16_t one{ 1 };
+		std::uint8_t first_byte;
+		std::memcpy(&first_byte, &one, 1);
+		return (first_byte == 1) ? byte_order::little_endian : byte_order::big_endian;
+	}
+
+	namespace kernels {
+
+		namespace scalar {
+
+			// Swaps the two bytes of each element, from src to dst (which may be equal).
+			inline void swap_bytes(const std::uint16_t* const src, std::uint16_t* const dst, const std::size_t size) {
+				for (std::size_t i{}; i < size; ++i) {
+					dst[i] = static_cast<std::uint16_t>((src[i] << 8U) | (src[i] >> 8U));
+				}
+			}
+		}
+
+#ifdef BIOVAULT_BFLOAT16_HAS_SSE2
+		namespace sse2 {
+
+			inline void swap_bytes(const std::uint16_t* const src, std::uint16_t* const dst, const std::size_t size) {
+				std::size_t i{};
+
+				for (; i + 8 <= size; i += 8) {
+					const __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+					_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_or_si128(_mm_slli_epi16(x, 8), _mm_srli_epi16(x, 8)));
+				}
+				scalar::swap_bytes(src + i, dst + i, size - i);
+			}
+		}
+#endif
+
+#ifdef BIOVAULT_BFLOAT16_HAS_AVX2
+		namespace avx2 {
+
+			inline void swap_bytes(const std::uint16_t* const src, std::uint16_t* const dst, const std::size_t size) {
+				std::size_t i{};
+
+				for (; i + 16 <= size; i += 16) {
+					const __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i));
+					_mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), _mm256_or_si256(_mm256_slli_epi16(x, 8), _mm256_srli_epi16(x, 8)));
+				}
+				sse2::swap_bytes(src + i, dst + i, size - i);
+			}
+		}
+#endif
+	}
+
+	namespace io_detail {
+
+		// Number of elements per chunk, when byte swapping is needed for stream I/O.
+		constexpr std::size_t chunk_size{ 4096 };
+
+		inline const std::uint16_t* as_uint16_pointer(const void* const ptr) {
+			return static_cast<const std::uint16_t*>(ptr);
+		}
+
+		inline std::uint16_t* as_uint16_pointer(void* const ptr) {
+			return static_cast<std::uint16_t*>(ptr);
+		}
+
+		inline void throw_runtime_error(const std::string& message) {
+			throw std::runtime_error("biovault_bfloat16_io: " + message);
+		}
+	}
+
+
+	// Writes the raw bits of 'size' elements to dst (2 * size bytes) in the specified byte order.
+	inline void serialize(const bfloat16_t* const src, const std::size_t size, std::uint8_t* const dst, const byte_order order)
+	{
+		if (order == native_byte_order()) {
+			std::memcpy(dst, src, size * sizeof(bfloat16_t));
+		}
+		else {
+			// Swap via an aligned, cache-resident chunk, so that dst needs no particular alignment.
+			std::uint16_t chunk[io_detail::chunk_size];
+
+			for (std::size_t i{}; i < size; i += io_detail::chunk_size) {
+				const auto count = std::min(io_detail::chunk_size, size - i);
+				kernels::native::swap_bytes(io_detail::as_uint16_pointer(src + i), chunk, count);
+				std::memcpy(dst + 2 * i, chunk, count * sizeof(std::uint16_t));
+			}
+		}
+	}
+
+	// Reads 'size' elements from src (2 * size bytes), stored in the specified byte order.
+	inline void deserialize(const std::uint8_t* const src, const std::size_t size, bfloat16_t* const dst, const byte_order order)
+	{
+		std::memcpy(dst, src, size * sizeof(bfloat16_t));
+
+		if (order != native_byte_order()) {
+			kernels::native::swap_bytes(io_detail::as_uint16_pointer(dst), io_detail::as_uint16_pointer(dst), size);
+		}
+	}
+
+	// Writes 'size' elements to the stream in the specified byte order. Throws
+	// std::runtime_error when writing fails.
+	inline void write_bfloat16_array(std::ostream& stream, const bfloat16_t* const data, const std::size_t size, const byte_order order)
+	{
+		if (order == native_byte_order()) {
+			stream.write(reinterpret_cast<const char*>(data), static_cast<std::streamsize>(size * sizeof(bfloat16_t)));
+		}
+		else {
+			std::uint8_t chunk[io_detail::chunk_size * sizeof(bfloat16_t)];
+
+			for (std::size_t i{}; (i < size) && stream; i += io_detail::chunk_size) {
+				const auto count = std::min(io_detail::chunk_size, size - i);
+				serialize(data + i, count, chunk, order);
+				stream.write(reinterpret_cast<const char*>(chunk), static_cast<std::streamsize>(count * sizeof(bfloat16_t)));
+			}
+		}
+		if (!stream) {
+			io_detail::throw_runtime_error("failed to write bfloat16 array");
+		}
+	}
+
+	// Reads 'size' elements from the stream, stored in the specified byte order.
+	// Throws std::runtime_error when reading fails.
+	inline void read_bfloat16_array(std::istream& stream, bfloat16_t* const data, const std::size_t size, const byte_order order)
+	{
+		if (!stream.read(reinterpret_cast<char*>(data), static_cast<std::streamsize>(size * sizeof(bfloat16_t)))) {
+			io_detail::throw_runtime_error("failed to read bfloat16 array");
+		}
+		if (order != native_byte_order()) {
+			kernels::native::swap_bytes(io_detail::as_uint16_pointer(data), io_detail::as_uint16_pointer(data), size);
+		}
+	}
+
+
+	// The header information of a .npy file with bfloat16 elements.
+	struct npy_header {
+		std::vector<std::size_t> shape;
+		bool fortran_order{};
+		byte_order order{ byte_order::little_endian };
+
+		// Offset of the array data, from the start of the file.
+		std::size_t data_offset{};
+
+		std::size_t element_count() const {
+			std::size_t result{ 1 };
+
+			for (const auto dimension : shape) {
+				result *= dimension;
+			}
+			return result;
+		}
+	};
+
+	// An array read from a .npy file. The elements are in the order of the file
+	// (column-major when fortran_order is true).
+	struct npy_array {
+		std::vector<std::size_t> shape;
+		bool fortran_order{};
+		std::vector<bfloat16_t> data;
+	};
+
+	namespace io_detail {
+
+		constexpr char npy_magic[]{ "\x93NUMPY" };
+		constexpr std::size_t npy_magic_size{ 6 };
+
+		// NumPy aligns the array data to 64 bytes.
+		constexpr std::size_t npy_alignment{ 64 };
+
+		inline std::string npy_header_string(const std::vector<std::size_t>& shape, const byte_order order) {
+			std::string dictionary{ "{'descr': '" };
+			// Void types have no byte order (NumPy reads '>V2' as '|V2'), so big-endian
+			// elements are described as raw unsigned 16-bit integers.
+			dictionary += (order == byte_order::little_endian) ? "<V2" : ">u2";
+			dictionary += "', 'fortran_order': False, 'shape': (";
+
+			for (const auto dimension : shape) {
+				dictionary += std::to_string(dimension) + ", ";
+			}
+			if (shape.size() > 1) {
+				// Python writes (2, 3) and (2,).
+				dictionary.resize(dictionary.size() - 1);
+				dictionary.back() = ')';
+			}
+			else {
+				if (shape.size() == 1) {
+					dictionary.pop_back();
+				}
+				dictionary += ')';
+			}
+			dictionary += ", }";
+
+			// Version 1.0: magic, two version bytes, and a two-byte little-endian
+			// header length. The header is padded with spaces and ends with a newline.
+			const auto prefix_size = npy_magic_size + 4;
+			const auto unpadded_size = prefix_size + dictionary.size() + 1;
+			const auto padded_size = (unpadded_size + npy_alignment - 1) / npy_alignment * npy_alignment;
+			const auto header_length = padded_size - prefix_size;
+
+			if (header_length > 0xFFFFU) {
+				throw_runtime_error("the .npy header is too long");
+			}
+			std::string result(npy_magic, npy_magic_size);
+			result += '\x01';
+			result += '\x00';
+			result += static_cast<char>(header_length & 0xFFU);
+			result += static_cast<char>(header_length >> 8U);
+			result += dictionary;
+			result.append(padded_size - unpadded_size, ' ');
+			result += '\n';
+			return result;
+		}
+
+		inline std::size_t skip_spaces(const std::string& text, std::size_t position) {
+			while ((position < text.size()) && ((text[position] == ' ') || (text[position] == '\t'))) {
+				++position;
+			}
+			return position;
+		}
+
+		// Returns the position just after the colon that follows the specified key
+		// (quoted by either single or double quotes) in the header dictionary.
+		inline std::size_t find_value(const std::string& dictionary, const char* const key) {
+			for (const char quote : { '\'', '"' }) {
+				const auto position = dictionary.find(quote + std::string(key) + quote);
+
+				if (position != std::string::npos) {
+					const auto colon_position = skip_spaces(dictionary, position + std::strlen(key) + 2);
+
+					if ((colon_position < dictionary.size()) && (dictionary[colon_position] == ':')) {
+						return skip_spaces(dictionary, colon_position + 1);
+					}
+				}
+			}
+			throw_runtime_error(std::string("the .npy header has no '") + key + "' key");
+			return std::string::npos;
+		}
+
+		inline npy_header parse_npy_header(const std::string& dictionary, const std::size_t data_offset) {
+			npy_header result;
+			result.data_offset = data_offset;
+
+			auto position = find_value(dictionary, "descr");
+
+			if ((position >= dictionary.size()) || ((dictionary[position] != '\'') && (dictionary[position] != '"'))) {
+				throw_runtime_error("the .npy descr is not a string");
+			}
+			const auto end_position = dictionary.find(dictionary[position], position + 1);
+
+			if (end_position == std::string::npos) {
+				throw_runtime_error("the .npy descr is not terminated");
+			}
+			const auto descr = dictionary.substr(position + 1, end_position - position - 1);
+
+			// 'V2' is how NumPy describes ml_dtypes.bfloat16. Unsigned 16-bit integers
+			// ('u2') are accepted as well, as raw bits.
+			if ((descr == "<V2") || (descr == "|V2") || (descr == "<u2") || (descr == "bfloat16")) {
+				result.order = byte_order::little_endian;
+			}
+			else if ((descr == ">V2") || (descr == ">u2")) {
+				result.order = byte_order::big_endian;
+			}
+			else {
+				throw_runtime_error("the .npy descr '" + descr + "' is not supported for bfloat16");
+			}
+
+			position = find_value(dictionary, "fortran_order");
+
+			if (dictionary.compare(position, 4, "True") == 0) {
+				result.fortran_order = true;
+			}
+			else if (dictionary.compare(position, 5, "False") != 0) {
+				throw_runtime_error("the .npy fortran_order is not a boolean");
+			}
+
+			position = find_value(dictionary, "shape");
+
+			if ((position >= dictionary.size()) || (dictionary[position] != '(')) {
+				throw_runtime_error("the .npy shape is not a tuple");
+			}
+			for (position = skip_spaces(dictionary, position + 1); (position < dictionary.size()) && (dictionary[position] != ')'); ) {
+				if ((dictionary[position] < '0') || (dictionary[position] > '9')) {
+					throw_runtime_error("the .npy shape has an invalid dimension");
+				}
+				std::size_t dimension{};
+
+				for (; (position < dictionary.size()) && (dictionary[position] >= '0') && (dictionary[position] <= '9'); ++position) {
+					const auto digit = static_cast<std::size_t>(dictionary[position] - '0');
+
+					if (dimension > (std::numeric_limits<std::size_t>::max() - digit) / 10) {
+						throw_runtime_error("the .npy shape has a dimension that is too large");
+					}
+					dimension = 10 * dimension + digit;
+				}
+				result.shape.push_back(dimension);
+				position = skip_spaces(dictionary, position);
+
+				if ((position < dictionary.size()) && (dictionary[position] == ',')) {
+					position = skip_spaces(dictionary, position + 1);
+				}
+			}
+			if (position >= dictionary.size()) {
+				throw_runtime_error("the .npy shape is not terminated");
+			}
+
+			// The number of bytes of the array must fit in a size_t (unless the array is empty).
+			if (std::find(result.shape.cbegin(), result.shape.cend(), std::size_t{}) == result.shape.cend()) {
+				std::size_t max_element_count{ std::numeric_limits<std::size_t>::max() / sizeof(bfloat16_t) };
+
+				for (const auto dimension : result.shape) {
+					if (dimension > max_element_count) {
+						throw_runtime_error("the .npy shape has too many elements");
+					}
+					max_element_count /= dimension;
+				}
+			}
+			return result;
+		}
+
+		// Maximum length of a .npy header (the dictionary and its padding). NumPy
+		// itself rejects headers longer than 10000 bytes, by default.
+		constexpr std::size_t npy_max_header_length{ std::size_t{ 1 } << 16U };
+
+		// The magic string, the version, and the header length, at the start of a .npy file.
+		struct npy_prefix {
+			std::size_t size;
+			std::size_t header_length;
+		};
+
+		// Reads the prefix from the start of the specified bytes, checking the
+		// magic string, the version (1.0, 2.0, or 3.0) and the header length before
+		// anything is allocated for the header.
+		inline npy_prefix read_npy_prefix(const std::uint8_t* const bytes, const std::size_t size) {
+			if ((size < npy_magic_size + 4) || (std::memcmp(bytes, npy_magic, npy_magic_size) != 0)) {
+				throw_runtime_error("not a .npy file");
+			}
+			const auto major_version = bytes[npy_magic_size];
+			npy_prefix result{ npy_magic_size + 4, std::size_t{ bytes[npy_magic_size + 2] } | (std::size_t{ bytes[npy_magic_size + 3] } << 8U) };
+
+			if ((major_version == 2) || (major_version == 3)) {
+				if (size < npy_magic_size + 6) {
+					throw_runtime_error("the .npy header is truncated");
+				}
+				result.header_length |= (std::size_t{ bytes[npy_magic_size + 4] } << 16U) | (std::size_t{ bytes[npy_magic_size + 5] } << 24U);
+				result.size += 2;
+			}
+			else if (major_version != 1) {
+				throw_runtime_error("the .npy format version is not supported");
+			}
+			if (result.header_length > npy_max_header_length) {
+				throw_runtime_error("the .npy header is too long");
+			}
+			return result;
+		}
+
+		// Parses the header at the start of the specified bytes (at least the first
+		// 'size' bytes of the file), supporting .npy format versions 1.0, 2.0, and 3.0.
+		inline npy_header read_npy_header(const std::uint8_t* const bytes, const std::size_t size) {
+			const auto prefix = read_npy_prefix(bytes, size);
+
+			if (size < prefix.size + prefix.header_length) {
+				throw_runtime_error("the .npy header is truncated");
+			}
+			return parse_npy_header(std::string(reinterpret_cast<const char*>(bytes) + prefix.size, prefix.header_length),
+				prefix.size + prefix.header_length);
+		}
+
+		inline npy_header read_npy_header(std::istream& stream) {
+			// The prefix is at most npy_magic_size + 6 bytes, and a .npy file is always
+			// larger, as its header is padded to a multiple of 64 bytes.
+			std::vector<std::uint8_t> bytes(npy_magic_size + 6);
+
+			if (!stream.read(reinterpret_cast<char*>(bytes.data()), static_cast<std::streamsize>(bytes.size()))) {
+				throw_runtime_error("not a .npy file");
+			}
+			const auto prefix = read_npy_prefix(bytes.data(), bytes.size());
+			const auto already_read = bytes.size();
+			bytes.resize(prefix.size + prefix.header_length);
+
+			if ((bytes.size() > already_read) &&
+				!stream.read(reinterpret_cast<char*>(bytes.data() + already_read), static_cast<std::streamsize>(bytes.size() - already_read))) {
+				throw_runtime_error("the .npy header is truncated");
+			}
+			return read_npy_header(bytes.data(), bytes.size());
+		}
+	}
+
+
+	// Writes a .npy file (format version 1.0) with the specified shape, readable by
+	// numpy.load, and then by .view(ml_dtypes.bfloat16). A big-endian file has
+	// descr '>u2', which needs .astype('<u2') before the view. Throws
+	// std::runtime_error when writing fails.
+	inline void write_npy(std::ostream& stream, const bfloat16_t* const data, const std::vector<std::size_t>& shape,
+		const byte_order order = byte_order::little_endian)
+	{
+		const auto header = io_detail::npy_header_string(shape, order);
+		stream.write(header.data(), static_cast<std::streamsize>(header.size()));
+
+		std::size_t element_count{ 1 };
+
+		for (const auto dimension : shape) {
+			element_count *= dimension;
+		}
+		write_bfloat16_array(stream, data, element_count, order);
+	}
+
+	inline void write_npy(const std::string& file_name, const bfloat16_t* const data, const std::vector<std::size_t>& shape,
+		const byte_order order = byte_order::little_endian)
+	{
+		std::ofstream stream(file_name, std::ios::binary);
+
+		if (!stream) {
+			io_detail::throw_runtime_error("failed to create '" + file_name + "'");
+		}
+		write_npy(stream, data, shape, order);
+	}
+
+	// Reads a .npy file with bfloat16 (or raw 16-bit unsigned integer) elements,
+	// converting the elements to the native byte order.
+	inline npy_array read_npy(std::istream& stream)
+	{
+		const auto header = io_detail::read_npy_header(stream);
+		const auto element_count = header.element_count();
+		npy_array result{ header.shape, header.fortran_order, {} };
+
+		// Reads chunk by chunk, so that the memory allocated for a truncated file
+		// (whose header may specify any shape) is bounded by its actual size.
+		constexpr std::size_t chunk_size{ std::size_t{ 1 } << 20U };
+
+		for (std::size_t i{}; i < element_count; i += chunk_size) {
+			const auto size = std::min(chunk_size, element_count - i);
+			result.data.resize(i + size);
+			read_bfloat16_array(stream, result.data.data() + i, size, header.order);
+		}
+		return result;
+	}
+
+	inline npy_array read_npy(const std::string& file_name)
+	{
+		std::ifstream stream(file_name, std::ios::binary);
+
+		if (!stream) {
+			io_detail::throw_runtime_error("failed to open '" + file_name + "'");
+		}
+		return read_npy(stream);
+	}
+
+
+	// A read-only memory-mapped .npy file with bfloat16 elements. When the byte
+	// order of the file is native, data() points directly into the mapping (zero
+	// copy). Otherwise, the elements are converted once, into memory owned by
+	// this object.
+	class npy_mapped_file {
+	public:
+		// Maps the specified file. Throws std::runtime_error when the file cannot be
+		// mapped, or is not a supported .npy file.
+		explicit npy_mapped_file(const std::string& file_name) {
+			map(file_name);
+
+			try {
+				header_ = io_detail::read_npy_header(mapped_bytes_, mapped_size_);
+				const auto byte_count = header_.element_count() * sizeof(bfloat16_t);
+
+				if (mapped_size_ - std::min(mapped_size_, header_.data_offset) < byte_count) {
+					io_detail::throw_runtime_error("the .npy file '" + file_name + "' is truncated");
+				}
+				const auto* const array_bytes = mapped_bytes_ + header_.data_offset;
+
+				if ((header_.order == native_byte_order()) && (header_.data_offset % alignof(bfloat16_t) == 0)) {
+					data_ = reinterpret_cast<const bfloat16_t*>(array_bytes);
+				}
+				else {
+					converted_data_.resize(header_.element_count());
+					deserialize(array_bytes, converted_data_.size(), converted_data_.data(), header_.order);
+					data_ = converted_data_.data();
+				}
+			}
+			catch (...) {
+				unmap();
+				throw;
+			}
+		}
+
+		npy_mapped_file(npy_mapped_file&& other) noexcept
+			:
+			mapped_bytes_(std::exchange(other.mapped_bytes_, nullptr)),
+			mapped_size_(std::exchange(other.mapped_size_, 0)),
+#ifdef _WIN32
+			mapping_handle_(std::exchange(other.mapping_handle_, nullptr)),
+#endif
+			header_(std::move(other.header_)),
+			converted_data_(std::move(other.converted_data_)),
+			data_(converted_data_.empty() ? std::exchange(other.data_, nullptr) : converted_data_.data())
+		{
+		}
+
+		npy_mapped_file& operator=(npy_mapped_file&& other) noexcept {
+			if (this != &other) {
+				unmap();
+				mapped_bytes_ = std::exchange(other.mapped_bytes_, nullptr);
+				mapped_size_ = std::exchange(other.mapped_size_, 0);
+#ifdef _WIN32
+				mapping_handle_ = std::exchange(other.mapping_handle_, nullptr);
+#endif
+				header_ = std::move(other.header_);
+				converted_data_ = std::move(other.converted_data_);
+				data_ = converted_data_.empty() ? other.data_ : converted_data_.data();
+				other.data_ = nullptr;
+			}
+			return *this;
+		}
+
+		npy_mapped_file(const npy_mapped_file&) = delete;
+		npy_mapped_file& operator=(const npy_mapped_file&) = delete;
+
+		~npy_mapped_file() {
+			unmap();
+		}
+
+		const std::vector<std::size_t>& shape() const { return header_.shape; }
+		bool fortran_order() const { return header_.fortran_order; }
+		std::size_t size() const { return header_.element_count(); }
+		const bfloat16_t* data() const { return data_; }
+
+		// Tells whether data() points directly into the mapped file.
+		bool is_zero_copy() const { return converted_data_.empty() && (size() > 0); }
+
+	private:
+		void map(const std::string& file_name) {
+#ifdef _WIN32
+			const HANDLE file_handle = CreateFileA(file_name.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+				FILE_ATTRIBUTE_NORMAL, nullptr);
+
+			if (file_handle == INVALID_HANDLE_VALUE) {
+				io_detail::throw_runtime_error("failed to open '" + file_name + "'");
+			}
+			LARGE_INTEGER file_size;
+
+			if (!GetFileSizeEx(file_handle, &file_size) || (file_size.QuadPart == 0)) {
+				CloseHandle(file_handle);
+				io_detail::throw_runtime_error("failed to map '" + file_name + "'");
+			}
+			mapping_handle_ = CreateFileMappingA(file_handle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+			CloseHandle(file_handle);
+
+			if (mapping_handle_ == nullptr) {
+				io_detail::throw_runtime_error("failed to map '" + file_name + "'");
+			}
+			const void* const address = MapViewOfFile(mapping_handle_, FILE_MAP_READ, 0, 0, 0);
+
+			if (address == nullptr) {
+				CloseHandle(mapping_handle_);
+				mapping_handle_ = nullptr;
+				io_detail::throw_runtime_error("failed to map '" + file_name + "'");
+			}
+			mapped_bytes_ = static_cast<const std::uint8_t*>(address);
+			mapped_size_ = static_cast<std::size_t>(file_size.QuadPart);
+#else
+			const int file_descriptor = ::open(file_name.c_str(), O_RDONLY);
+
+			if (file_descriptor < 0) {
+				io_detail::throw_runtime_error("failed to open '" + file_name + "'");
+			}
+			struct stat file_status;
+
+			if ((::fstat(file_descriptor, &file_status) != 0) || (file_status.st_size <= 0)) {
+				::close(file_descriptor);
+				io_detail::throw_runtime_error("failed to map '" + file_name + "'");
+			}
+			const auto size = static_cast<std::size_t>(file_status.st_size);
+			void* const address = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, file_descriptor, 0);
+			::close(file_descriptor);
+
+			if (address == MAP_FAILED) {
+				io_detail::throw_runtime_error("failed to map '" + file_name + "'");
+			}
+			mapped_bytes_ = static_cast<const std::uint8_t*>(address);
+			mapped_size_ = size;
+#endif
+		}
+
+		void unmap() noexcept {
+			if (mapped_bytes_ != nullptr) {
+#ifdef _WIN32
+				UnmapViewOfFile(mapped_bytes_);
+				CloseHandle(mapping_handle_);
+				mapping_handle_ = nullptr;
+#else
+				::munmap(const_cast<std::uint8_t*>(mapped_bytes_), mapped_size_);
+#endif
+				mapped_bytes_ = nullptr;
+				mapped_size_ = 0;
+			}
+		}
+
+		const std::uint8_t* mapped_bytes_{};
+		std::size_t mapped_size_{};
+#ifdef _WIN32
+		HANDLE mapping_handle_{};
+#endif
+		npy_header header_;
+		std::vector<bfloat16_t> converted_data_;
+		const bfloat16_t* data_{};
+	};
+}
+
+#endif
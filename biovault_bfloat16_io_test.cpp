@@ -0,0 +1,336 @@
+/*******************************************************************************
+* Copyright 2020 LKEB, Leiden University Medical Center
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*******************************************************************************/
+
+// The file to be tested. Included twice here, to check its include guards!
+#include "biovault_bfloat16_io.h"
+#include "biovault_bfloat16_io.h"
+
+// GoogleTest header file:
+#include <gtest/gtest.h>
+
+// Standard library header files:
+#include <cstdint>
+#include <cstdio>  // For remove.
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+
+namespace
+{
+	using biovault::bfloat16_t;
+	using biovault::byte_order;
+
+
+	// Returns 'size' elements with distinct raw bits (including NaNs and infinities).
+	std::vector<bfloat16_t> make_values(const std::size_t size)
+	{
+		std::vector<bfloat16_t> result;
+		result.reserve(size);
+
+		for (std::size_t i{}; i < size; ++i)
+		{
+			result.emplace_back(static_cast<std::uint16_t>(i * 40503U), true);
+		}
+		return result;
+	}
+
+
+	void expect_equal_raw_bits(const std::vector<bfloat16_t>& expected, const bfloat16_t* const actual)
+	{
+		for (std::size_t i{}; i < expected.size(); ++i)
+		{
+			ASSERT_EQ(get_raw_bits(actual[i]), get_raw_bits(expected[i])) << "i = " << i;
+		}
+	}
+
+
+	std::string temporary_file_name(const char* const name)
+	{
+		return ::testing::TempDir() + name;
+	}
+
+
+	void write_file(const std::string& file_name, const std::string& contents)
+	{
+		std::ofstream stream(file_name, std::ios::binary);
+		stream.write(contents.data(), static_cast<std::streamsize>(contents.size()));
+	}
+
+
+	// Returns a version 1.0 .npy header, padded as NumPy does.
+	std::string make_npy_header(const std::string& dictionary)
+	{
+		auto padded_dictionary = dictionary;
+
+		while ((10 + padded_dictionary.size() + 1) % 64 != 0)
+		{
+			padded_dictionary += ' ';
+		}
+		padded_dictionary += '\n';
+
+		std::string result("\x93NUMPY\x01\x00", 8);
+		result += static_cast<char>(padded_dictionary.size() & 0xFFU);
+		result += static_cast<char>(padded_dictionary.size() >> 8U);
+		return result + padded_dictionary;
+	}
+
+}
+
+
+GTEST_TEST(bfloat16_io, SerializeStoresLittleAndBigEndianBytes)
+{
+	const bfloat16_t values[] = { bfloat16_t(0x1234, true), bfloat16_t(0xABCD, true) };
+	std::uint8_t bytes[4];
+
+	biovault::serialize(values, 2, bytes, byte_order::little_endian);
+	EXPECT_EQ(bytes[0], 0x34);
+	EXPECT_EQ(bytes[1], 0x12);
+	EXPECT_EQ(bytes[2], 0xCD);
+	EXPECT_EQ(bytes[3], 0xAB);
+
+	biovault::serialize(values, 2, bytes, byte_order::big_endian);
+	EXPECT_EQ(bytes[0], 0x12);
+	EXPECT_EQ(bytes[1], 0x34);
+	EXPECT_EQ(bytes[2], 0xAB);
+	EXPECT_EQ(bytes[3], 0xCD);
+}
+
+
+GTEST_TEST(bfloat16_io, DeserializeRoundTrips)
+{
+	// Sizes that exercise both the vectorized part and the remainder, and more than one chunk.
+	for (const std::size_t size : { 0, 1, 7, 8, 15, 16, 17, 33, 10000 })
+	{
+		const auto values = make_values(size);
+
+		for (const auto order : { byte_order::little_endian, byte_order::big_endian })
+		{
+			std::vector<std::uint8_t> bytes(2 * size + 1);
+
+			// Use an odd offset, to check that no particular alignment is required.
+			biovault::serialize(values.data(), size, bytes.data() + 1, order);
+
+			std::vector<bfloat16_t> result(size);
+			biovault::deserialize(bytes.data() + 1, size, result.data(), order);
+			expect_equal_raw_bits(values, result.data());
+		}
+	}
+}
+
+
+GTEST_TEST(bfloat16_io, SwapBytesKernelsAreEquivalent)
+{
+	std::vector<std::uint16_t> input(1000);
+
+	for (std::size_t i{}; i < input.size(); ++i)
+	{
+		input[i] = static_cast<std::uint16_t>(i * 2654435761U);
+	}
+	std::vector<std::uint16_t> expected(input.size());
+	biovault::kernels::scalar::swap_bytes(input.data(), expected.data(), input.size());
+
+	EXPECT_EQ(expected[1], static_cast<std::uint16_t>((input[1] << 8U) | (input[1] >> 8U)));
+
+	std::vector<std::uint16_t> actual(input.size());
+	biovault::kernels::native::swap_bytes(input.data(), actual.data(), input.size());
+	EXPECT_EQ(actual, expected);
+}
+
+
+GTEST_TEST(bfloat16_io, StreamRoundTrips)
+{
+	const auto values = make_values(9999);
+
+	for (const auto order : { byte_order::little_endian, byte_order::big_endian })
+	{
+		std::stringstream stream;
+		biovault::write_bfloat16_array(stream, values.data(), values.size(), order);
+		EXPECT_EQ(stream.str().size(), 2 * values.size());
+
+		std::vector<bfloat16_t> result(values.size());
+		biovault::read_bfloat16_array(stream, result.data(), result.size(), order);
+		expect_equal_raw_bits(values, result.data());
+
+		EXPECT_THROW(biovault::read_bfloat16_array(stream, result.data(), 1, order), std::runtime_error);
+	}
+}
+
+
+GTEST_TEST(bfloat16_io, WriteNpyWritesNumPyHeader)
+{
+	const auto values = make_values(6);
+	std::ostringstream stream;
+	biovault::write_npy(stream, values.data(), { 2, 3 });
+
+	const auto contents = stream.str();
+	EXPECT_EQ(contents.size(), 128 + 12);
+	EXPECT_EQ(contents.substr(0, 8), std::string("\x93NUMPY\x01\x00", 8));
+	EXPECT_EQ(contents[8], 118);
+	EXPECT_EQ(contents[9], 0);
+	EXPECT_EQ(contents.substr(10, 59), "{'descr': '<V2', 'fortran_order': False, 'shape': (2, 3), }");
+	EXPECT_EQ(contents.substr(69, 59), std::string(58, ' ') + '\n');
+
+	// Big-endian elements are described as unsigned integers, as void types have no byte order.
+	std::ostringstream big_endian_stream;
+	biovault::write_npy(big_endian_stream, values.data(), { 2, 3 }, byte_order::big_endian);
+	const auto big_endian_contents = big_endian_stream.str();
+	ASSERT_EQ(big_endian_contents.size(), 128 + 12);
+	EXPECT_EQ(big_endian_contents.substr(10, 59), "{'descr': '>u2', 'fortran_order': False, 'shape': (2, 3), }");
+	EXPECT_EQ(big_endian_contents[128], static_cast<char>(biovault::get_raw_bits(values[0]) >> 8U));
+
+	std::ostringstream one_dimensional_stream;
+	biovault::write_npy(one_dimensional_stream, values.data(), { 6 });
+	EXPECT_NE(one_dimensional_stream.str().find("'shape': (6,), }"), std::string::npos);
+
+	std::ostringstream scalar_stream;
+	biovault::write_npy(scalar_stream, values.data(), {});
+	EXPECT_NE(scalar_stream.str().find("'shape': (), }"), std::string::npos);
+	EXPECT_EQ(scalar_stream.str().size() % 64, 2);
+}
+
+
+GTEST_TEST(bfloat16_io, NpyRoundTrips)
+{
+	const auto values = make_values(3 * 4 * 5);
+	const std::vector<std::size_t> shape{ 3, 4, 5 };
+
+	for (const auto order : { byte_order::little_endian, byte_order::big_endian })
+	{
+		std::stringstream stream;
+		biovault::write_npy(stream, values.data(), shape, order);
+
+		const auto array = biovault::read_npy(stream);
+		EXPECT_EQ(array.shape, shape);
+		EXPECT_FALSE(array.fortran_order);
+		ASSERT_EQ(array.data.size(), values.size());
+		expect_equal_raw_bits(values, array.data.data());
+	}
+}
+
+
+GTEST_TEST(bfloat16_io, ReadNpyParsesHeadersWrittenByNumPy)
+{
+	// The header of numpy.save(f, numpy.array([[1, 2, 3]], dtype=ml_dtypes.bfloat16).T), and some variations.
+	const std::uint8_t data[] = { 0x80, 0x3F, 0x00, 0x40, 0x40, 0x40 };
+	const std::string data_string(reinterpret_cast<const char*>(data), sizeof(data));
+
+	for (const char* const dictionary : {
+		"{'descr': '<V2', 'fortran_order': True, 'shape': (3, 1), }",
+		"{'descr': '|V2', 'fortran_order': True, 'shape': (3, 1), }",
+		"{'descr': '<u2', 'fortran_order': True, 'shape': (3, 1), }",
+		"{\"shape\": (3,1), \"descr\": \"<V2\", \"fortran_order\": True}" })
+	{
+		std::istringstream stream(make_npy_header(dictionary) + data_string);
+		const auto array = biovault::read_npy(stream);
+		EXPECT_EQ(array.shape, (std::vector<std::size_t>{ 3, 1 }));
+		EXPECT_TRUE(array.fortran_order);
+		ASSERT_EQ(array.data.size(), 3);
+		EXPECT_FLOAT_EQ(array.data[0], 1.0f);
+		EXPECT_FLOAT_EQ(array.data[1], 2.0f);
+		EXPECT_FLOAT_EQ(array.data[2], 3.0f);
+	}
+}
+
+
+GTEST_TEST(bfloat16_io, ReadNpyThrowsOnUnsupportedFiles)
+{
+	for (const char* const dictionary : {
+		"{'descr': '<f2', 'fortran_order': False, 'shape': (1,), }",
+		"{'descr': '<f4', 'fortran_order': False, 'shape': (1,), }",
+		"{'descr': '<V2', 'shape': (1,), }",
+		"{'descr': '<V2', 'fortran_order': False, 'shape': (1, -1), }",
+		"{'descr': '<V2', 'fortran_order': False, 'shape': (1,",
+		"{'descr': '<V2', 'fortran_order': False, 'shape': (9223372036854775809, 2), }",
+		"{'descr': '<V2', 'fortran_order': False, 'shape': (4294967296, 4294967296), }",
+		"{'descr': '<V2', 'fortran_order': False, 'shape': (99999999999999999999999,), }",
+		"{'descr': '<V2', 'fortran_order': False, 'shape': (1099511627776,), }" })
+	{
+		std::istringstream stream(make_npy_header(dictionary) + "1234");
+		EXPECT_THROW(biovault::read_npy(stream), std::runtime_error) << dictionary;
+	}
+
+	std::istringstream not_npy_stream("not a .npy file, not a .npy file, not a .npy file");
+	EXPECT_THROW(biovault::read_npy(not_npy_stream), std::runtime_error);
+
+	std::istringstream truncated_stream(make_npy_header("{'descr': '<V2', 'fortran_order': False, 'shape': (3,), }") + "1234");
+	EXPECT_THROW(biovault::read_npy(truncated_stream), std::runtime_error);
+
+	EXPECT_THROW(biovault::read_npy(temporary_file_name("biovault_bfloat16_io_test_nonexistent.npy")), std::runtime_error);
+}
+
+
+GTEST_TEST(bfloat16_io, ReadNpyChecksPrefixBeforeAllocatingHeader)
+{
+	// Bytes that would be taken for a header length of almost 4 GiB, if the
+	// magic string and the version were not checked first.
+	for (const auto& contents : {
+		std::string(50, '\xFF'),
+		std::string("\x93NUMPX\x02\x00\xFF\xFF\xFF\xFF", 12) + std::string(38, ' '),
+		std::string("\x93NUMPY\x04\x00\xFF\xFF\xFF\xFF", 12) + std::string(38, ' '),
+		std::string("\x93NUMPY\x02\x00\xFF\xFF\xFF\xFF", 12) + std::string(38, ' ') })
+	{
+		std::istringstream stream(contents);
+		EXPECT_THROW(biovault::read_npy(stream), std::runtime_error);
+	}
+}
+
+
+GTEST_TEST(bfloat16_io, MappedFileIsZeroCopyForNativeByteOrder)
+{
+	const auto file_name = temporary_file_name("biovault_bfloat16_io_test_mapped.npy");
+	const auto values = make_values(12345);
+	const std::vector<std::size_t> shape{ 5, 2469 };
+
+	for (const auto order : { byte_order::little_endian, byte_order::big_endian })
+	{
+		biovault::write_npy(file_name, values.data(), shape, order);
+		{
+			const biovault::npy_mapped_file mapped_file(file_name);
+			EXPECT_EQ(mapped_file.shape(), shape);
+			EXPECT_FALSE(mapped_file.fortran_order());
+			ASSERT_EQ(mapped_file.size(), values.size());
+			EXPECT_EQ(mapped_file.is_zero_copy(), order == biovault::native_byte_order());
+			expect_equal_raw_bits(values, mapped_file.data());
+
+			// Moving keeps the data valid.
+			biovault::npy_mapped_file moved_file(file_name);
+			const auto* const data = moved_file.data();
+			const biovault::npy_mapped_file new_file(std::move(moved_file));
+			EXPECT_EQ(new_file.is_zero_copy(), order == biovault::native_byte_order());
+
+			if (new_file.is_zero_copy())
+			{
+				EXPECT_EQ(new_file.data(), data);
+			}
+			expect_equal_raw_bits(values, new_file.data());
+		}
+		EXPECT_EQ(std::remove(file_name.c_str()), 0);
+	}
+}
+
+
+GTEST_TEST(bfloat16_io, MappedFileThrowsOnTruncatedFile)
+{
+	const auto file_name = temporary_file_name("biovault_bfloat16_io_test_truncated.npy");
+	write_file(file_name, make_npy_header("{'descr': '<V2', 'fortran_order': False, 'shape': (3,), }") + "1234");
+	EXPECT_THROW(biovault::npy_mapped_file{ file_name }, std::runtime_error);
+	EXPECT_EQ(std::remove(file_name.c_str()), 0);
+
+	EXPECT_THROW(biovault::npy_mapped_file{ temporary_file_name("biovault_bfloat16_io_test_nonexistent.npy") }, std::runtime_error);
+}
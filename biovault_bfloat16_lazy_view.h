@@ -0,0 +1,342 @@
+#ifndef BIOVAULT_BFLOAT16_LAZY_VIEW_H_INCLUDE_GUARD
+#define BIOVAULT_BFLOAT16_LAZY_VIEW_H_INCLUDE_GUARD
+
+/*******************************************************************************
+* Copyright 2020 LKEB, Leiden University Medical Center
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*******************************************************************************/
+
+// A read-only view that presents an array of bfloat16_t elements as floats,
+// without widening the whole array up front. The array is divided into tiles
+// of a fixed number of elements, which are widened on first access, into a
+// least-recently-used cache of a bounded number of tiles.
+//
+// The view may be accessed by multiple threads concurrently. Each thread
+// remembers the tile it accessed last (its "hot tile"), so that consecutive
+// accesses to the same tile do not need to lock the cache. Kernels that need
+// contiguous floats may pin a tile, which keeps it in the cache until it is
+// unpinned.
+
+#include "biovault_bfloat16.h"
+#include "biovault_bfloat16_bulk.h"
+
+#include <algorithm> // For min.
+#include <atomic>
+#include <cstddef>   // For size_t.
+#include <cstdint>   // For uint64_t.
+#include <list>
+#include <memory>    // For shared_ptr.
+#include <mutex>
+#include <stdexcept> // For invalid_argument and out_of_range.
+#include <unordered_map>
+#include <utility>   // For exchange.
+#include <vector>
+
+namespace biovault {
+
+	struct tile_cache_statistics {
+		// Accesses to a tile that was already widened (including the accesses to
+		// the hot tile of a thread).
+		std::size_t hit_count{};
+
+		// Accesses that required a tile to be widened.
+		std::size_t miss_count{};
+
+		// Tiles removed from the cache, to stay within its capacity.
+		std::size_t eviction_count{};
+
+		std::size_t resident_tile_count{};
+	};
+
+	namespace lazy_view_detail {
+
+		struct tile {
+			std::size_t index;
+			std::vector<float> values;
+
+			// Guarded by the mutex of the view.
+			std::size_t pin_count;
+		};
+
+		// The hot tile of a thread. The hits on the hot tile are counted locally,
+		// and added to the (shared) hit counter of the view when the thread moves
+		// on to another tile.
+		struct hot_tile_entry {
+			std::uint64_t view_id{};
+
+			// The elements [first_index, first_index + size) of the view, owned by hot_tile.
+			const float* values{};
+			std::size_t first_index{};
+			std::size_t size{};
+
+			std::shared_ptr<const tile> hot_tile;
+			std::shared_ptr<std::atomic<std::size_t>> hit_counter;
+			std::size_t pending_hit_count{};
+
+			void flush() {
+				if (pending_hit_count > 0) {
+					hit_counter->fetch_add(pending_hit_count, std::memory_order_relaxed);
+					pending_hit_count = 0;
+				}
+			}
+
+			~hot_tile_entry() {
+				flush();
+			}
+		};
+
+		inline hot_tile_entry& this_thread_hot_tile() {
+			static thread_local hot_tile_entry entry;
+			return entry;
+		}
+
+		// Returns a unique (non-zero) id for each view, so that a hot tile is never
+		// mistaken for a tile of another view at the same address.
+		inline std::uint64_t new_view_id() {
+			static std::atomic<std::uint64_t> last_id{};
+			return ++last_id;
+		}
+	}
+
+
+	class lazy_float_view {
+	public:
+		// A tile that stays in the cache (and keeps its address) until this object
+		// is destructed.
+		class pinned_tile {
+		public:
+			pinned_tile(pinned_tile&& other) noexcept
+				:
+				view_(std::exchange(other.view_, nullptr)),
+				tile_(std::move(other.tile_))
+			{
+			}
+
+			pinned_tile& operator=(pinned_tile&& other) noexcept {
+				if (this != &other) {
+					unpin();
+					view_ = std::exchange(other.view_, nullptr);
+					tile_ = std::move(other.tile_);
+				}
+				return *this;
+			}
+
+			pinned_tile(const pinned_tile&) = delete;
+			pinned_tile& operator=(const pinned_tile&) = delete;
+
+			~pinned_tile() {
+				unpin();
+			}
+
+			// The widened elements [first_index(), first_index() + size()) of the array.
+			const float* data() const { return tile_->values.data(); }
+			std::size_t size() const { return tile_->values.size(); }
+			std::size_t first_index() const { return tile_->index * view_->tile_size_; }
+
+		private:
+			friend class lazy_float_view;
+
+			pinned_tile(const lazy_float_view& view, std::shared_ptr<const lazy_view_detail::tile> tile)
+				:
+				view_(&view),
+				tile_(std::move(tile))
+			{
+			}
+
+			void unpin() noexcept {
+				if (view_ != nullptr) {
+					view_->unpin(*tile_);
+					view_ = nullptr;
+					tile_.reset();
+				}
+			}
+
+			const lazy_float_view* view_;
+			std::shared_ptr<const lazy_view_detail::tile> tile_;
+		};
+
+		// Creates a view of the specified array, which must stay alive (and
+		// unmodified) during the lifetime of the view. At most 'max_tile_count'
+		// tiles stay in the cache, plus the hot tile of each thread, and the tiles
+		// that are pinned. Throws std::invalid_argument when the tile size or the
+		// maximum number of tiles is zero.
+		lazy_float_view(const bfloat16_t* const data, const std::size_t size,
+			const std::size_t tile_size = 4096, const std::size_t max_tile_count = 64)
+			:
+			data_(data),
+			size_(size),
+			tile_size_(tile_size),
+			max_tile_count_(max_tile_count),
+			id_(lazy_view_detail::new_view_id()),
+			hit_counter_(std::make_shared<std::atomic<std::size_t>>(0))
+		{
+			if ((tile_size == 0) || (max_tile_count == 0)) {
+				throw std::invalid_argument("lazy_float_view: the tile size and the maximum number of tiles must be non-zero");
+			}
+		}
+
+		lazy_float_view(const lazy_float_view&) = delete;
+		lazy_float_view& operator=(const lazy_float_view&) = delete;
+
+		std::size_t size() const { return size_; }
+		std::size_t tile_size() const { return tile_size_; }
+		std::size_t tile_count() const { return (size_ + tile_size_ - 1) / tile_size_; }
+		std::size_t max_tile_count() const { return max_tile_count_; }
+
+		// Returns element i, widened to float. Does not check the index.
+		float operator[](const std::size_t i) const {
+			auto& entry = lazy_view_detail::this_thread_hot_tile();
+
+			if ((entry.view_id == id_) && (i - entry.first_index < entry.size)) {
+				++entry.pending_hit_count;
+				return entry.values[i - entry.first_index];
+			}
+			entry.flush();
+			entry.hot_tile = find_or_widen(i / tile_size_, 0);
+			entry.view_id = id_;
+			entry.values = entry.hot_tile->values.data();
+			entry.first_index = entry.hot_tile->index * tile_size_;
+			entry.size = entry.hot_tile->values.size();
+			entry.hit_counter = hit_counter_;
+			return entry.values[i - entry.first_index];
+		}
+
+		// Returns element i, widened to float. Throws std::out_of_range when i is
+		// not less than size().
+		float at(const std::size_t i) const {
+			if (i >= size_) {
+				throw std::out_of_range("lazy_float_view: index out of range");
+			}
+			return (*this)[i];
+		}
+
+		// Pins the tile with the specified index, widening it when necessary.
+		// Throws std::out_of_range when the tile index is not less than tile_count().
+		pinned_tile pin_tile(const std::size_t tile_index) const {
+			if (tile_index >= tile_count()) {
+				throw std::out_of_range("lazy_float_view: tile index out of range");
+			}
+			return pinned_tile(*this, find_or_widen(tile_index, 1));
+		}
+
+		tile_cache_statistics statistics() const {
+			lazy_view_detail::this_thread_hot_tile().flush();
+
+			const std::lock_guard<std::mutex> lock(mutex_);
+			tile_cache_statistics result = statistics_;
+			result.hit_count += hit_counter_->load(std::memory_order_relaxed);
+			result.resident_tile_count = tiles_.size();
+			return result;
+		}
+
+		void reset_statistics() {
+			lazy_view_detail::this_thread_hot_tile().flush();
+
+			const std::lock_guard<std::mutex> lock(mutex_);
+			statistics_ = tile_cache_statistics{};
+			hit_counter_->store(0, std::memory_order_relaxed);
+		}
+
+	private:
+		using tile_list = std::list<std::shared_ptr<lazy_view_detail::tile>>;
+
+		// Returns the tile with the specified index, moving it to the front of
+		// the least-recently-used list, and adds 'pin_count' to its pin count. The
+		// tile is widened without holding the lock, so that other threads can
+		// access other tiles in the meantime.
+		std::shared_ptr<const lazy_view_detail::tile> find_or_widen(const std::size_t tile_index, const std::size_t pin_count) const {
+			{
+				const std::lock_guard<std::mutex> lock(mutex_);
+				const auto found = tile_map_.find(tile_index);
+
+				if (found != tile_map_.end()) {
+					++statistics_.hit_count;
+					return use(found->second, pin_count);
+				}
+			}
+
+			const auto first_index = tile_index * tile_size_;
+			auto new_tile = std::make_shared<lazy_view_detail::tile>();
+			new_tile->index = tile_index;
+			new_tile->values.resize(std::min(tile_size_, size_ - first_index));
+			new_tile->pin_count = 0;
+			convert_bfloat16_to_float(data_ + first_index, new_tile->values.data(), new_tile->values.size());
+
+			const std::lock_guard<std::mutex> lock(mutex_);
+			const auto found = tile_map_.find(tile_index);
+
+			if (found != tile_map_.end()) {
+				// Another thread has widened the same tile in the meantime.
+				++statistics_.hit_count;
+				return use(found->second, pin_count);
+			}
+			++statistics_.miss_count;
+			tiles_.push_front(std::move(new_tile));
+			tile_map_.emplace(tile_index, tiles_.begin());
+			const auto result = use(tiles_.begin(), pin_count);
+			evict();
+			return result;
+		}
+
+		std::shared_ptr<const lazy_view_detail::tile> use(const tile_list::iterator position, const std::size_t pin_count) const {
+			tiles_.splice(tiles_.begin(), tiles_, position);
+			(*position)->pin_count += pin_count;
+			return *position;
+		}
+
+		// Removes the least recently used tiles that are not pinned, while the
+		// cache exceeds its capacity. (Hot tiles of threads stay alive, outside
+		// the cache, until those threads move on.)
+		void evict() const {
+			auto position = tiles_.end();
+
+			while ((tiles_.size() > max_tile_count_) && (position != tiles_.begin())) {
+				--position;
+
+				if ((*position)->pin_count == 0) {
+					tile_map_.erase((*position)->index);
+					position = tiles_.erase(position);
+					++statistics_.eviction_count;
+				}
+			}
+		}
+
+		void unpin(const lazy_view_detail::tile& tile) const {
+			const std::lock_guard<std::mutex> lock(mutex_);
+			const auto found = tile_map_.find(tile.index);
+
+			if (found != tile_map_.end()) {
+				--(*found->second)->pin_count;
+			}
+			evict();
+		}
+
+		const bfloat16_t* data_;
+		std::size_t size_;
+		std::size_t tile_size_;
+		std::size_t max_tile_count_;
+		std::uint64_t id_;
+
+		// Hits on hot tiles, shared with the threads, so that they can still add
+		// their pending hits after the view is destructed.
+		std::shared_ptr<std::atomic<std::size_t>> hit_counter_;
+
+		mutable std::mutex mutex_;
+		mutable tile_list tiles_;
+		mutable std::unordered_map<std::size_t, tile_list::iterator> tile_map_;
+		mutable tile_cache_statistics statistics_;
+	};
+}
+
+#endif
@@ -0,0 +1,228 @@
+/*******************************************************************************
+* Copyright 2020 LKEB, Leiden University Medical Center
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*******************************************************************************/
+
+// The file to be tested. Included twice here, to check its include guards!
+#include "biovault_bfloat16_lazy_view.h"
+#include "biovault_bfloat16_lazy_view.h"
+
+// GoogleTest header file:
+#include <gtest/gtest.h>
+
+// Standard library header files:
+#include <algorithm> // For min.
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <random>
+#include <stdexcept>
+#include <thread>
+#include <utility> // For move.
+#include <vector>
+
+
+namespace
+{
+	using biovault::bfloat16_t;
+	using biovault::lazy_float_view;
+
+
+	std::vector<bfloat16_t> make_values(const std::size_t size)
+	{
+		std::vector<bfloat16_t> result;
+		result.reserve(size);
+
+		for (std::size_t i{}; i < size; ++i)
+		{
+			result.emplace_back(static_cast<float>(i % 1000) - 500.0f);
+		}
+		return result;
+	}
+
+
+	bool equal_bits(const float actual, const bfloat16_t expected)
+	{
+		return biovault::get_raw_bits(bfloat16_t(actual)) == biovault::get_raw_bits(expected);
+	}
+
+}
+
+
+GTEST_TEST(bfloat16_lazy_view, ThrowsOnInvalidArguments)
+{
+	const auto values = make_values(10);
+	EXPECT_THROW(lazy_float_view(values.data(), values.size(), 0, 1), std::invalid_argument);
+	EXPECT_THROW(lazy_float_view(values.data(), values.size(), 1, 0), std::invalid_argument);
+
+	const lazy_float_view view(values.data(), values.size(), 4, 1);
+	EXPECT_THROW(view.at(10), std::out_of_range);
+	EXPECT_THROW(view.pin_tile(3), std::out_of_range);
+}
+
+
+GTEST_TEST(bfloat16_lazy_view, ReturnsWidenedElements)
+{
+	// The last tile is partial.
+	const auto values = make_values(1000);
+	const lazy_float_view view(values.data(), values.size(), 64, 3);
+
+	EXPECT_EQ(view.size(), 1000);
+	EXPECT_EQ(view.tile_count(), 16);
+
+	std::mt19937 generator;
+	std::uniform_int_distribution<std::size_t> distribution(0, values.size() - 1);
+
+	for (unsigned i{}; i < 10000; ++i)
+	{
+		const auto index = distribution(generator);
+		ASSERT_TRUE(equal_bits(view[index], values[index])) << index;
+		ASSERT_TRUE(equal_bits(view.at(index), values[index])) << index;
+	}
+	EXPECT_LE(view.statistics().resident_tile_count, 3);
+}
+
+
+GTEST_TEST(bfloat16_lazy_view, CountsHitsMissesAndEvictions)
+{
+	const auto values = make_values(100);
+	lazy_float_view view(values.data(), values.size(), 10, 2);
+
+	// Sequential access: one miss per tile, all other accesses are hits.
+	for (std::size_t i{}; i < values.size(); ++i)
+	{
+		static_cast<void>(view[i]);
+	}
+	auto statistics = view.statistics();
+	EXPECT_EQ(statistics.miss_count, 10);
+	EXPECT_EQ(statistics.hit_count, 90);
+	EXPECT_EQ(statistics.eviction_count, 8);
+	EXPECT_EQ(statistics.resident_tile_count, 2);
+
+	// Tiles 8 and 9 are still resident.
+	view.reset_statistics();
+	static_cast<void>(view[85]);
+	static_cast<void>(view[95]);
+	statistics = view.statistics();
+	EXPECT_EQ(statistics.miss_count, 0);
+	EXPECT_EQ(statistics.hit_count, 2);
+	EXPECT_EQ(statistics.eviction_count, 0);
+
+	// Tile 0 is not.
+	static_cast<void>(view[5]);
+	statistics = view.statistics();
+	EXPECT_EQ(statistics.miss_count, 1);
+	EXPECT_EQ(statistics.eviction_count, 1);
+}
+
+
+GTEST_TEST(bfloat16_lazy_view, PinnedTileStaysResident)
+{
+	const auto values = make_values(100);
+	lazy_float_view view(values.data(), values.size(), 10, 1);
+
+	auto pinned_tile = view.pin_tile(3);
+	ASSERT_EQ(pinned_tile.size(), 10);
+	EXPECT_EQ(pinned_tile.first_index(), 30);
+	const float* const data = pinned_tile.data();
+
+	for (std::size_t i{}; i < pinned_tile.size(); ++i)
+	{
+		EXPECT_TRUE(equal_bits(data[i], values[30 + i]));
+	}
+
+	// Access all other tiles, which evicts all unpinned tiles.
+	for (std::size_t i{}; i < values.size(); ++i)
+	{
+		static_cast<void>(view[i]);
+	}
+	view.reset_statistics();
+
+	// Pinning the same tile again yields the same (resident) data.
+	{
+		const auto same_tile = view.pin_tile(3);
+		EXPECT_EQ(same_tile.data(), data);
+		EXPECT_EQ(view.statistics().miss_count, 0);
+	}
+
+	// Moving keeps the tile pinned.
+	const auto moved_tile = std::move(pinned_tile);
+	static_cast<void>(view[0]);
+	EXPECT_EQ(view.pin_tile(3).data(), data);
+}
+
+
+GTEST_TEST(bfloat16_lazy_view, UnpinnedTileIsEvicted)
+{
+	const auto values = make_values(100);
+	const lazy_float_view view(values.data(), values.size(), 10, 1);
+
+	static_cast<void>(view.pin_tile(0));
+	static_cast<void>(view.pin_tile(1));
+	EXPECT_EQ(view.statistics().resident_tile_count, 1);
+}
+
+
+GTEST_TEST(bfloat16_lazy_view, ConcurrentRandomAccess)
+{
+	const auto values = make_values(1 << 16);
+	const lazy_float_view view(values.data(), values.size(), 256, 8);
+	std::atomic<std::size_t> mismatch_count{};
+	std::vector<std::thread> threads;
+
+	for (unsigned thread_number{}; thread_number < 4; ++thread_number)
+	{
+		threads.emplace_back([&view, &values, &mismatch_count, thread_number]
+		{
+			std::mt19937 generator(thread_number);
+			std::uniform_int_distribution<std::size_t> distribution(0, values.size() - 1);
+
+			for (unsigned i{}; i < 20000; ++i)
+			{
+				// Mostly short runs within a tile, sometimes a pinned tile.
+				const auto index = distribution(generator);
+
+				if (i % 100 == 0)
+				{
+					const auto tile = view.pin_tile(index / view.tile_size());
+
+					for (std::size_t j{}; j < tile.size(); ++j)
+					{
+						if (!equal_bits(tile.data()[j], values[tile.first_index() + j]))
+						{
+							++mismatch_count;
+						}
+					}
+				}
+				for (std::size_t j{ index }; j < std::min(index + 16, values.size()); ++j)
+				{
+					if (!equal_bits(view[j], values[j]))
+					{
+						++mismatch_count;
+					}
+				}
+			}
+		});
+	}
+	for (auto& thread : threads)
+	{
+		thread.join();
+	}
+	EXPECT_EQ(mismatch_count, 0);
+
+	const auto statistics = view.statistics();
+	EXPECT_LE(statistics.resident_tile_count, 8);
+	EXPECT_GT(statistics.miss_count, 0);
+	EXPECT_GT(statistics.hit_count, statistics.miss_count);
+}
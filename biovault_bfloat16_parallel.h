@@ -0,0 +1,115 @@
+#ifndef BIOVAULT_BFLOAT16_PARALLEL_H_INCLUDE_GUARD
+#define BIOVAULT_BFLOAT16_PARALLEL_H_INCLUDE_GUARD
+
+/*******************************************************************************
+* Copyright 2020 LKEB, Leiden University Medical Center
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*******************************************************************************/
+
+// Multithreaded bulk conversion between float and bfloat16_t, and the helper
+// function (parallel_for_ranges) that splits work across std::thread objects.
+
+#include "biovault_bfloat16_bulk.h"
+
+#include <algorithm> // For min.
+#include <cstddef>   // For size_t.
+#include <exception> // For exception_ptr.
+#include <thread>
+#include <vector>
+
+namespace biovault {
+
+	// Returns the number of threads to use when a thread count of zero is specified.
+	inline unsigned default_thread_count()
+	{
+		const auto thread_count = std::thread::hardware_concurrency();
+		return (thread_count == 0) ? 1U : thread_count;
+	}
+
+	// Splits [0, size) into at most 'thread_count' contiguous ranges, and calls
+	// function(begin, end, range_index) for each of them, on its own thread. The
+	// last range is processed by the calling thread. Each range has at least
+	// 'min_range_size' elements (except when 'size' is smaller), to avoid
+	// starting threads for little work. A thread count of zero selects
+	// default_thread_count(). An exception thrown by the function is rethrown
+	// once all threads are joined.
+	template <typename Function>
+	void parallel_for_ranges(const std::size_t size, unsigned thread_count, Function function,
+		const std::size_t min_range_size = 1)
+	{
+		if (thread_count == 0) {
+			thread_count = default_thread_count();
+		}
+		const std::size_t range_count{ std::max<std::size_t>(1,
+			std::min<std::size_t>(thread_count, size / std::max<std::size_t>(min_range_size, 1))) };
+
+		if (range_count == 1) {
+			function(std::size_t{}, size, std::size_t{});
+			return;
+		}
+
+		std::vector<std::thread> threads;
+		std::vector<std::exception_ptr> exceptions(range_count);
+		threads.reserve(range_count - 1);
+
+		const auto range_begin = [size, range_count](const std::size_t range_index) {
+			return (size / range_count) * range_index + std::min(range_index, size % range_count);
+		};
+
+		const auto process_range = [&function, &exceptions, range_begin](const std::size_t range_index) {
+			try {
+				function(range_begin(range_index), range_begin(range_index + 1), range_index);
+			}
+			catch (...) {
+				exceptions[range_index] = std::current_exception();
+			}
+		};
+
+		for (std::size_t range_index{}; range_index < range_count - 1; ++range_index) {
+			threads.emplace_back(process_range, range_index);
+		}
+		process_range(range_count - 1);
+
+		for (auto& thread : threads) {
+			thread.join();
+		}
+		for (const auto& exception : exceptions) {
+			if (exception) {
+				std::rethrow_exception(exception);
+			}
+		}
+	}
+
+	// Minimum number of elements per thread for the parallel bulk conversions:
+	// below this, starting a thread costs more than converting the elements.
+	constexpr std::size_t parallel_conversion_min_range_size{ std::size_t{ 1 } << 16U };
+
+	inline void parallel_convert_float_to_bfloat16(const float* const src, bfloat16_t* const dst, const std::size_t size,
+		const unsigned thread_count = 0)
+	{
+		parallel_for_ranges(size, thread_count, [src, dst](const std::size_t begin, const std::size_t end, std::size_t) {
+			convert_float_to_bfloat16(src + begin, dst + begin, end - begin);
+		}, parallel_conversion_min_range_size);
+	}
+
+	inline void parallel_convert_bfloat16_to_float(const bfloat16_t* const src, float* const dst, const std::size_t size,
+		const unsigned thread_count = 0)
+	{
+		parallel_for_ranges(size, thread_count, [src, dst](const std::size_t begin, const std::size_t end, std::size_t) {
+			convert_bfloat16_to_float(src + begin, dst + begin, end - begin);
+		}, parallel_conversion_min_range_size);
+	}
+}
+
+#endif
@@ -0,0 +1,106 @@
+/*******************************************************************************
+* Copyright 2020 LKEB, Leiden University Medical Center
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*******************************************************************************/
+
+// The file to be tested. Included twice here, to check its include guards!
+#include "biovault_bfloat16_parallel.h"
+#include "biovault_bfloat16_parallel.h"
+
+// GoogleTest header file:
+#include <gtest/gtest.h>
+
+// Standard library header files:
+#include <atomic>
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+
+
+GTEST_TEST(bfloat16_parallel, ParallelForRangesCoversEachIndexExactlyOnce)
+{
+	for (const std::size_t size : { 0U, 1U, 7U, 1000U, 1001U })
+	{
+		for (unsigned thread_count{ 1 }; thread_count <= 5; ++thread_count)
+		{
+			std::vector<int> visit_counts(size);
+			std::atomic<std::size_t> range_count{};
+
+			biovault::parallel_for_ranges(size, thread_count,
+				[&visit_counts, &range_count, thread_count](const std::size_t begin, const std::size_t end, const std::size_t range_index)
+			{
+				EXPECT_LT(range_index, thread_count);
+				EXPECT_LE(begin, end);
+				++range_count;
+
+				for (auto i = begin; i < end; ++i)
+				{
+					++visit_counts[i];
+				}
+			});
+
+			EXPECT_EQ(visit_counts, std::vector<int>(size, 1));
+			EXPECT_LE(range_count, thread_count);
+		}
+	}
+}
+
+
+GTEST_TEST(bfloat16_parallel, ParallelForRangesRespectsMinRangeSize)
+{
+	std::atomic<std::size_t> range_count{};
+
+	biovault::parallel_for_ranges(100, 8, [&range_count](std::size_t, std::size_t, std::size_t)
+	{
+		++range_count;
+	}, 40);
+
+	EXPECT_EQ(range_count, 2U);
+}
+
+
+GTEST_TEST(bfloat16_parallel, ParallelForRangesRethrowsException)
+{
+	EXPECT_THROW(biovault::parallel_for_ranges(100, 4, [](std::size_t, std::size_t, const std::size_t range_index)
+	{
+		if (range_index == 1)
+		{
+			throw std::runtime_error("Test exception");
+		}
+	}), std::runtime_error);
+}
+
+
+GTEST_TEST(bfloat16_parallel, ParallelConversionEqualsSequentialConversion)
+{
+	constexpr std::size_t size{ (std::size_t{ 1 } << 18U) + 3 };
+	std::vector<float> floats(size);
+
+	for (std::size_t i{}; i < size; ++i)
+	{
+		floats[i] = static_cast<float>(i) * 0.001f - 100.0f;
+	}
+
+	std::vector<biovault::bfloat16_t> expected(size);
+	std::vector<biovault::bfloat16_t> actual(size);
+	biovault::convert_float_to_bfloat16(floats.data(), expected.data(), size);
+	biovault::parallel_convert_float_to_bfloat16(floats.data(), actual.data(), size, 3);
+	EXPECT_EQ(std::memcmp(actual.data(), expected.data(), size * sizeof(biovault::bfloat16_t)), 0);
+
+	std::vector<float> expected_floats(size);
+	std::vector<float> actual_floats(size);
+	biovault::convert_bfloat16_to_float(expected.data(), expected_floats.data(), size);
+	biovault::parallel_convert_bfloat16_to_float(expected.data(), actual_floats.data(), size, 3);
+	EXPECT_EQ(std::memcmp(actual_floats.data(), expected_floats.data(), size * sizeof(float)), 0);
+}
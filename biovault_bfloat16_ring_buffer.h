@@ -0,0 +1,414 @@
+#ifndef BIOVAULT_BFLOAT16_RING_BUFFER_H_INCLUDE_GUARD
+#define BIOVAULT_BFLOAT16_RING_BUFFER_H_INCLUDE_GUARD
+
+/*******************************************************************************
+* Copyright 2020 LKEB, Leiden University Medical Center
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*******************************************************************************/
+
+// A lock-free single-producer/single-consumer ring buffer of fixed-size
+// frames of bfloat16_t elements, for streaming between threads or processes.
+//
+// frame_ring_buffer operates on a caller-provided memory region, which holds
+// both the control block (the read and write indices) and the frame slots.
+// shared_memory_ring_buffer places this region in POSIX shared memory
+// (shm_open), so that a producer process and a consumer process can each
+// attach to it by name. The producer may write float frames, which are
+// converted directly into the shared slot by the bulk conversion kernel. The
+// consumer gets zero-copy views of the frames in the shared slots.
+
+#include "biovault_bfloat16.h"
+#include "biovault_bfloat16_bulk.h"
+
+#include <atomic>
+#include <cstddef>   // For size_t.
+#include <cstdint>   // For uint64_t and uintptr_t.
+#include <cstring>   // For memcpy.
+#include <new>       // For placement new.
+#include <stdexcept> // For invalid_argument and runtime_error.
+#include <string>
+#include <utility>   // For exchange.
+
+#if defined(__unix__) || defined(__APPLE__)
+#define BIOVAULT_BFLOAT16_HAS_POSIX_SHARED_MEMORY 1
+#include <fcntl.h>    // For O_CREAT, O_EXCL, and O_RDWR.
+#include <sys/mman.h> // For mmap, munmap, shm_open, and shm_unlink.
+#include <sys/stat.h> // For fstat.
+#include <unistd.h>   // For close and ftruncate.
+#endif
+
+namespace biovault {
+
+	namespace ring_buffer_detail {
+
+		constexpr std::size_t cache_line_size{ 64 };
+
+		// Identifies an initialized control block (and its layout version).
+		constexpr std::uint64_t magic_number{ 0x3130524642564942U };
+
+		// The control block, at the start of the memory region. The write index
+		// and the read index are in separate cache lines (when the region is
+		// cache line aligned), so that the producer and the consumer do not
+		// invalidate each other's cache line when advancing their own index.
+		struct control_block {
+			std::atomic<std::uint64_t> magic;
+			std::uint64_t frame_size;
+			std::uint64_t slot_count;
+			std::uint64_t slot_stride;
+			unsigned char padding0[cache_line_size - 4 * sizeof(std::uint64_t)];
+
+			// The number of frames written, and the number of frames read so far.
+			std::atomic<std::uint64_t> write_index;
+			unsigned char padding1[cache_line_size - sizeof(std::uint64_t)];
+			std::atomic<std::uint64_t> read_index;
+			unsigned char padding2[cache_line_size - sizeof(std::uint64_t)];
+		};
+
+		// The indices must be address-free, to be shared between processes.
+		static_assert(ATOMIC_LLONG_LOCK_FREE == 2, "The ring buffer requires lock-free 64-bit atomics.");
+		static_assert(sizeof(control_block) == 3 * cache_line_size, "The control block should occupy three cache lines.");
+
+		// Returns the distance between the starts of two consecutive slots (in
+		// elements), rounded up to a multiple of the cache line size.
+		inline std::size_t slot_stride(const std::size_t frame_size) {
+			constexpr std::size_t elements_per_cache_line{ cache_line_size / sizeof(bfloat16_t) };
+			return (frame_size + elements_per_cache_line - 1) / elements_per_cache_line * elements_per_cache_line;
+		}
+	}
+
+
+	// A view of a single-producer/single-consumer ring buffer, in a memory region
+	// that is not owned by this object. Exactly one thread (in any process) may
+	// call the producer member functions, and exactly one thread the consumer
+	// member functions, concurrently.
+	class frame_ring_buffer {
+	public:
+		// The number of bytes of a memory region holding the specified number of
+		// slots, each of 'frame_size' elements.
+		static std::size_t required_size(const std::size_t frame_size, const std::size_t slot_count) {
+			return sizeof(ring_buffer_detail::control_block) +
+				slot_count * ring_buffer_detail::slot_stride(frame_size) * sizeof(bfloat16_t);
+		}
+
+		// Initializes an empty ring buffer in the specified region, which must be
+		// aligned to a cache line (64 bytes), so that the indices of the producer
+		// and the consumer do not share a cache line. Throws std::invalid_argument
+		// when the sizes are zero, or when the region is too small or misaligned.
+		static frame_ring_buffer initialize(void* const region, const std::size_t region_size,
+			const std::size_t frame_size, const std::size_t slot_count) {
+			if ((frame_size == 0) || (slot_count == 0)) {
+				throw std::invalid_argument("frame_ring_buffer: the frame size and the slot count must be non-zero");
+			}
+			check_region(region, region_size, required_size(frame_size, slot_count));
+
+			auto* const control = ::new (region) ring_buffer_detail::control_block{};
+			control->frame_size = frame_size;
+			control->slot_count = slot_count;
+			control->slot_stride = ring_buffer_detail::slot_stride(frame_size);
+			control->write_index.store(0, std::memory_order_relaxed);
+			control->read_index.store(0, std::memory_order_relaxed);
+
+			// Publishes the initialization, to anyone who attaches after seeing the magic number.
+			control->magic.store(ring_buffer_detail::magic_number, std::memory_order_release);
+			return frame_ring_buffer(control);
+		}
+
+		// Attaches to a ring buffer that was initialized (possibly by another
+		// process) in the specified region. Throws std::invalid_argument when the
+		// region does not hold an initialized ring buffer.
+		static frame_ring_buffer attach(void* const region, const std::size_t region_size) {
+			check_region(region, region_size, sizeof(ring_buffer_detail::control_block));
+
+			auto* const control = static_cast<ring_buffer_detail::control_block*>(region);
+
+			if (control->magic.load(std::memory_order_acquire) != ring_buffer_detail::magic_number) {
+				throw std::invalid_argument("frame_ring_buffer: the region does not hold an initialized ring buffer");
+			}
+			check_region(region, region_size,
+				required_size(static_cast<std::size_t>(control->frame_size), static_cast<std::size_t>(control->slot_count)));
+			return frame_ring_buffer(control);
+		}
+
+		std::size_t frame_size() const { return frame_size_; }
+		std::size_t slot_count() const { return slot_count_; }
+
+		// The number of frames that are written, but not yet read. (Only a
+		// snapshot, when the other side is active.)
+		std::size_t frame_count() const {
+			return static_cast<std::size_t>(control_->write_index.load(std::memory_order_acquire) -
+				control_->read_index.load(std::memory_order_acquire));
+		}
+
+		// Producer: returns the slot for the next frame, or null when all slots
+		// are occupied. The frame becomes visible to the consumer by commit_write().
+		bfloat16_t* try_begin_write() {
+			const auto write_index = control_->write_index.load(std::memory_order_relaxed);
+
+			if (write_index - cached_read_index_ >= slot_count_) {
+				// Only touches the cache line of the consumer when the buffer appears full.
+				cached_read_index_ = control_->read_index.load(std::memory_order_acquire);
+
+				if (write_index - cached_read_index_ >= slot_count_) {
+					return nullptr;
+				}
+			}
+			return slot(write_index);
+		}
+
+		// Producer: publishes the frame written into the slot from try_begin_write().
+		void commit_write() {
+			control_->write_index.store(control_->write_index.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+		}
+
+		// Producer: copies a frame into the next slot. Returns false when all slots are occupied.
+		bool try_write(const bfloat16_t* const frame) {
+			bfloat16_t* const destination = try_begin_write();
+
+			if (destination == nullptr) {
+				return false;
+			}
+			std::memcpy(destination, frame, frame_size_ * sizeof(bfloat16_t));
+			commit_write();
+			return true;
+		}
+
+		// Producer: converts a float frame directly into the next slot. Returns
+		// false when all slots are occupied.
+		bool try_write(const float* const frame) {
+			bfloat16_t* const destination = try_begin_write();
+
+			if (destination == nullptr) {
+				return false;
+			}
+			convert_float_to_bfloat16(frame, destination, frame_size_);
+			commit_write();
+			return true;
+		}
+
+		// Consumer: returns a zero-copy view of the oldest frame, or null when no
+		// frame is available. The slot remains valid until end_read().
+		const bfloat16_t* try_begin_read() {
+			const auto read_index = control_->read_index.load(std::memory_order_relaxed);
+
+			if (read_index == cached_write_index_) {
+				cached_write_index_ = control_->write_index.load(std::memory_order_acquire);
+
+				if (read_index == cached_write_index_) {
+					return nullptr;
+				}
+			}
+			return slot(read_index);
+		}
+
+		// Consumer: releases the slot of the frame from try_begin_read(), to the producer.
+		void end_read() {
+			control_->read_index.store(control_->read_index.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+		}
+
+		// Consumer: copies the oldest frame. Returns false when no frame is available.
+		bool try_read(bfloat16_t* const frame) {
+			const bfloat16_t* const source = try_begin_read();
+
+			if (source == nullptr) {
+				return false;
+			}
+			std::memcpy(frame, source, frame_size_ * sizeof(bfloat16_t));
+			end_read();
+			return true;
+		}
+
+		// Consumer: converts the oldest frame to float. Returns false when no frame is available.
+		bool try_read(float* const frame) {
+			const bfloat16_t* const source = try_begin_read();
+
+			if (source == nullptr) {
+				return false;
+			}
+			convert_bfloat16_to_float(source, frame, frame_size_);
+			end_read();
+			return true;
+		}
+
+	private:
+		explicit frame_ring_buffer(ring_buffer_detail::control_block* const control)
+			:
+			control_(control),
+			slots_(reinterpret_cast<bfloat16_t*>(control + 1)),
+			frame_size_(static_cast<std::size_t>(control->frame_size)),
+			slot_count_(static_cast<std::size_t>(control->slot_count)),
+			slot_stride_(static_cast<std::size_t>(control->slot_stride)),
+			cached_read_index_(control->read_index.load(std::memory_order_acquire)),
+			cached_write_index_(control->write_index.load(std::memory_order_acquire))
+		{
+		}
+
+		static void check_region(const void* const region, const std::size_t region_size, const std::size_t required_region_size) {
+			if ((region == nullptr) || (reinterpret_cast<std::uintptr_t>(region) % ring_buffer_detail::cache_line_size != 0)) {
+				throw std::invalid_argument("frame_ring_buffer: the region is null or misaligned");
+			}
+			if (region_size < required_region_size) {
+				throw std::invalid_argument("frame_ring_buffer: the region is too small");
+			}
+		}
+
+		bfloat16_t* slot(const std::uint64_t index) const {
+			return slots_ + static_cast<std::size_t>(index % slot_count_) * slot_stride_;
+		}
+
+		ring_buffer_detail::control_block* control_;
+		bfloat16_t* slots_;
+		std::size_t frame_size_;
+		std::size_t slot_count_;
+		std::size_t slot_stride_;
+
+		// Local copies of the index of the other side, which may lag behind.
+		std::uint64_t cached_read_index_;
+		std::uint64_t cached_write_index_;
+	};
+
+
+#ifdef BIOVAULT_BFLOAT16_HAS_POSIX_SHARED_MEMORY
+
+	// A frame_ring_buffer in a named POSIX shared memory object. The producer
+	// process typically calls create, and the consumer process open. The shared
+	// memory object persists until remove is called (or the system reboots).
+	class shared_memory_ring_buffer {
+	public:
+		// Creates a new shared memory object with the specified name (of the form
+		// "/name"), holding an empty ring buffer. Throws std::runtime_error when the
+		// object cannot be created (for example, because it already exists).
+		static shared_memory_ring_buffer create(const std::string& name, const std::size_t frame_size, const std::size_t slot_count) {
+			if ((frame_size == 0) || (slot_count == 0)) {
+				throw std::invalid_argument("shared_memory_ring_buffer: the frame size and the slot count must be non-zero");
+			}
+			const int file_descriptor = ::shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+
+			if (file_descriptor < 0) {
+				throw std::runtime_error("shared_memory_ring_buffer: failed to create '" + name + "'");
+			}
+			const auto size = frame_ring_buffer::required_size(frame_size, slot_count);
+
+			if (::ftruncate(file_descriptor, static_cast<off_t>(size)) != 0) {
+				::close(file_descriptor);
+				::shm_unlink(name.c_str());
+				throw std::runtime_error("shared_memory_ring_buffer: failed to resize '" + name + "'");
+			}
+			void* const address = map(file_descriptor, size);
+
+			if (address == nullptr) {
+				::shm_unlink(name.c_str());
+				throw std::runtime_error("shared_memory_ring_buffer: failed to map '" + name + "'");
+			}
+			return shared_memory_ring_buffer(address, size,
+				frame_ring_buffer::initialize(address, size, frame_size, slot_count));
+		}
+
+		// Opens an existing shared memory object, holding a ring buffer created by
+		// create. Throws std::runtime_error when the object cannot be opened, or
+		// does not (yet) hold an initialized ring buffer.
+		static shared_memory_ring_buffer open(const std::string& name) {
+			const int file_descriptor = ::shm_open(name.c_str(), O_RDWR, 0);
+
+			if (file_descriptor < 0) {
+				throw std::runtime_error("shared_memory_ring_buffer: failed to open '" + name + "'");
+			}
+			struct stat file_status;
+
+			if ((::fstat(file_descriptor, &file_status) != 0) ||
+				(static_cast<std::size_t>(file_status.st_size) < sizeof(ring_buffer_detail::control_block))) {
+				::close(file_descriptor);
+				throw std::runtime_error("shared_memory_ring_buffer: '" + name + "' is not initialized");
+			}
+			const auto size = static_cast<std::size_t>(file_status.st_size);
+			void* const address = map(file_descriptor, size);
+
+			if (address == nullptr) {
+				throw std::runtime_error("shared_memory_ring_buffer: failed to map '" + name + "'");
+			}
+			try {
+				return shared_memory_ring_buffer(address, size, frame_ring_buffer::attach(address, size));
+			}
+			catch (const std::invalid_argument&) {
+				::munmap(address, size);
+				throw std::runtime_error("shared_memory_ring_buffer: '" + name + "' is not initialized");
+			}
+		}
+
+		// Removes the name of the shared memory object. Mappings that are still
+		// open remain valid. Returns false when there is no such object.
+		static bool remove(const std::string& name) {
+			return ::shm_unlink(name.c_str()) == 0;
+		}
+
+		shared_memory_ring_buffer(shared_memory_ring_buffer&& other) noexcept
+			:
+			address_(std::exchange(other.address_, nullptr)),
+			size_(std::exchange(other.size_, 0)),
+			ring_buffer_(other.ring_buffer_)
+		{
+		}
+
+		shared_memory_ring_buffer& operator=(shared_memory_ring_buffer&& other) noexcept {
+			if (this != &other) {
+				unmap();
+				address_ = std::exchange(other.address_, nullptr);
+				size_ = std::exchange(other.size_, 0);
+				ring_buffer_ = other.ring_buffer_;
+			}
+			return *this;
+		}
+
+		shared_memory_ring_buffer(const shared_memory_ring_buffer&) = delete;
+		shared_memory_ring_buffer& operator=(const shared_memory_ring_buffer&) = delete;
+
+		~shared_memory_ring_buffer() {
+			unmap();
+		}
+
+		frame_ring_buffer& ring_buffer() { return ring_buffer_; }
+		const frame_ring_buffer& ring_buffer() const { return ring_buffer_; }
+
+	private:
+		shared_memory_ring_buffer(void* const address, const std::size_t size, const frame_ring_buffer& ring_buffer)
+			:
+			address_(address),
+			size_(size),
+			ring_buffer_(ring_buffer)
+		{
+		}
+
+		// Maps the whole object, and closes the file descriptor. Returns null on failure.
+		static void* map(const int file_descriptor, const std::size_t size) {
+			void* const address = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, file_descriptor, 0);
+			::close(file_descriptor);
+			return (address == MAP_FAILED) ? nullptr : address;
+		}
+
+		void unmap() noexcept {
+			if (address_ != nullptr) {
+				::munmap(address_, size_);
+				address_ = nullptr;
+				size_ = 0;
+			}
+		}
+
+		void* address_;
+		std::size_t size_;
+		frame_ring_buffer ring_buffer_;
+	};
+
+#endif
+}
+
+#endif
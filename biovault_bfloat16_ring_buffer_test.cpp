@@ -0,0 +1,359 @@
+/*******************************************************************************
+* Copyright 2020 LKEB, Leiden University Medical Center
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*******************************************************************************/
+
+// The file to be tested. Included twice here, to check its include guards!
+#include "biovault_bfloat16_ring_buffer.h"
+#include "biovault_bfloat16_ring_buffer.h"
+
+// GoogleTest header file:
+#include <gtest/gtest.h>
+
+// Standard library header files:
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility> // For move.
+#include <vector>
+
+#ifdef BIOVAULT_BFLOAT16_HAS_POSIX_SHARED_MEMORY
+#include <sys/wait.h> // For waitpid.
+#include <unistd.h>   // For fork, getpid, and _exit.
+#endif
+
+
+namespace
+{
+	using biovault::bfloat16_t;
+	using biovault::frame_ring_buffer;
+
+
+	// A memory region for a ring buffer, aligned to a cache line.
+	class aligned_region
+	{
+	public:
+		explicit aligned_region(const std::size_t size)
+			:
+			m_storage((size + 2 * 64) / sizeof(std::uint64_t))
+		{
+			const auto address = reinterpret_cast<std::uintptr_t>(m_storage.data());
+			m_data = m_storage.data() + ((64 - address % 64) % 64) / sizeof(std::uint64_t);
+		}
+
+		void* data()
+		{
+			return m_data;
+		}
+
+	private:
+		std::vector<std::uint64_t> m_storage;
+		std::uint64_t* m_data;
+	};
+
+
+	// The value of element i of frame number 'frame_number', exactly representable by bfloat16.
+	float frame_value(const std::size_t frame_number, const std::size_t i)
+	{
+		return static_cast<float>((frame_number * 7 + i) % 256);
+	}
+
+
+#ifdef BIOVAULT_BFLOAT16_HAS_POSIX_SHARED_MEMORY
+	// Returns a name that is unique to this process, and short enough for macOS,
+	// which limits shared memory names to 31 characters (PSHMNAMLEN).
+	std::string unique_shared_memory_name(const char* const suffix)
+	{
+		return "/bvbf16_" + std::to_string(::getpid()) + '_' + suffix;
+	}
+#endif
+
+}
+
+
+GTEST_TEST(bfloat16_ring_buffer, RequiredSizePadsSlotsToCacheLines)
+{
+	EXPECT_EQ(frame_ring_buffer::required_size(1, 1), 3 * 64 + 64);
+	EXPECT_EQ(frame_ring_buffer::required_size(32, 2), 3 * 64 + 2 * 64);
+	EXPECT_EQ(frame_ring_buffer::required_size(33, 3), 3 * 64 + 3 * 128);
+}
+
+
+GTEST_TEST(bfloat16_ring_buffer, ThrowsOnInvalidArguments)
+{
+	aligned_region region(frame_ring_buffer::required_size(10, 4));
+
+	EXPECT_THROW(frame_ring_buffer::initialize(region.data(), frame_ring_buffer::required_size(10, 4), 0, 4), std::invalid_argument);
+	EXPECT_THROW(frame_ring_buffer::initialize(region.data(), frame_ring_buffer::required_size(10, 4), 10, 0), std::invalid_argument);
+	EXPECT_THROW(frame_ring_buffer::initialize(region.data(), frame_ring_buffer::required_size(10, 4) - 1, 10, 4), std::invalid_argument);
+	EXPECT_THROW(frame_ring_buffer::initialize(nullptr, frame_ring_buffer::required_size(10, 4), 10, 4), std::invalid_argument);
+
+	// 8-byte aligned, but not aligned to a cache line.
+	aligned_region larger_region(frame_ring_buffer::required_size(10, 4) + 64);
+	EXPECT_THROW(frame_ring_buffer::initialize(static_cast<std::uint64_t*>(larger_region.data()) + 1,
+		frame_ring_buffer::required_size(10, 4), 10, 4), std::invalid_argument);
+
+	// Not yet initialized.
+	EXPECT_THROW(frame_ring_buffer::attach(region.data(), frame_ring_buffer::required_size(10, 4)), std::invalid_argument);
+
+	frame_ring_buffer::initialize(region.data(), frame_ring_buffer::required_size(10, 4), 10, 4);
+	EXPECT_NO_THROW(frame_ring_buffer::attach(region.data(), frame_ring_buffer::required_size(10, 4)));
+	EXPECT_THROW(frame_ring_buffer::attach(region.data(), frame_ring_buffer::required_size(10, 3)), std::invalid_argument);
+}
+
+
+GTEST_TEST(bfloat16_ring_buffer, WritesAndReadsFramesInOrder)
+{
+	constexpr std::size_t frame_size{ 37 };
+	constexpr std::size_t slot_count{ 3 };
+	const auto region_size = frame_ring_buffer::required_size(frame_size, slot_count);
+	aligned_region region(region_size);
+
+	auto producer = frame_ring_buffer::initialize(region.data(), region_size, frame_size, slot_count);
+	auto consumer = frame_ring_buffer::attach(region.data(), region_size);
+
+	EXPECT_EQ(consumer.frame_size(), frame_size);
+	EXPECT_EQ(consumer.slot_count(), slot_count);
+	EXPECT_EQ(consumer.try_begin_read(), nullptr);
+
+	std::vector<float> float_frame(frame_size);
+	std::vector<bfloat16_t> bfloat16_frame(frame_size);
+	std::size_t write_count{};
+	std::size_t read_count{};
+
+	for (unsigned round{}; round < 5; ++round)
+	{
+		// Fill the buffer, alternating between float and bfloat16 frames.
+		for (;; ++write_count)
+		{
+			for (std::size_t i{}; i < frame_size; ++i)
+			{
+				float_frame[i] = frame_value(write_count, i);
+				bfloat16_frame[i] = bfloat16_t(float_frame[i]);
+			}
+			const bool written = (write_count % 2 == 0) ? producer.try_write(float_frame.data()) : producer.try_write(bfloat16_frame.data());
+
+			if (!written)
+			{
+				break;
+			}
+		}
+		EXPECT_EQ(producer.frame_count(), slot_count);
+		EXPECT_EQ(producer.try_begin_write(), nullptr);
+
+		// Read all but one frame, using both the zero-copy view and copying.
+		for (; read_count + 1 < write_count; ++read_count)
+		{
+			if (read_count % 2 == 0)
+			{
+				const bfloat16_t* const frame = consumer.try_begin_read();
+				ASSERT_NE(frame, nullptr);
+
+				for (std::size_t i{}; i < frame_size; ++i)
+				{
+					EXPECT_FLOAT_EQ(frame[i], frame_value(read_count, i));
+				}
+				consumer.end_read();
+			}
+			else
+			{
+				ASSERT_TRUE(consumer.try_read(float_frame.data()));
+
+				for (std::size_t i{}; i < frame_size; ++i)
+				{
+					EXPECT_FLOAT_EQ(float_frame[i], frame_value(read_count, i));
+				}
+			}
+		}
+		EXPECT_EQ(consumer.frame_count(), 1);
+	}
+}
+
+
+GTEST_TEST(bfloat16_ring_buffer, StreamsBetweenThreads)
+{
+	constexpr std::size_t frame_size{ 1000 };
+	constexpr std::size_t frame_count{ 20000 };
+	constexpr std::size_t slot_count{ 4 };
+	const auto region_size = frame_ring_buffer::required_size(frame_size, slot_count);
+	aligned_region region(region_size);
+
+	auto producer = frame_ring_buffer::initialize(region.data(), region_size, frame_size, slot_count);
+	auto consumer = frame_ring_buffer::attach(region.data(), region_size);
+
+	std::thread producer_thread([&producer]
+	{
+		std::vector<float> frame(frame_size);
+
+		for (std::size_t frame_number{}; frame_number < frame_count; ++frame_number)
+		{
+			for (std::size_t i{}; i < frame_size; ++i)
+			{
+				frame[i] = frame_value(frame_number, i);
+			}
+			while (!producer.try_write(frame.data()))
+			{
+				std::this_thread::yield();
+			}
+		}
+	});
+
+	std::size_t mismatch_count{};
+
+	for (std::size_t frame_number{}; frame_number < frame_count; ++frame_number)
+	{
+		const bfloat16_t* frame;
+
+		while ((frame = consumer.try_begin_read()) == nullptr)
+		{
+			std::this_thread::yield();
+		}
+		for (std::size_t i{}; i < frame_size; ++i)
+		{
+			if (biovault::get_raw_bits(frame[i]) != biovault::get_raw_bits(bfloat16_t(frame_value(frame_number, i))))
+			{
+				++mismatch_count;
+			}
+		}
+		consumer.end_read();
+	}
+	producer_thread.join();
+	EXPECT_EQ(mismatch_count, 0);
+	EXPECT_EQ(consumer.frame_count(), 0);
+}
+
+
+#ifdef BIOVAULT_BFLOAT16_HAS_POSIX_SHARED_MEMORY
+
+GTEST_TEST(bfloat16_ring_buffer, SharedMemoryCreateAndOpen)
+{
+	using biovault::shared_memory_ring_buffer;
+
+	const auto name = unique_shared_memory_name("open");
+	shared_memory_ring_buffer::remove(name);
+	EXPECT_THROW(shared_memory_ring_buffer::open(name), std::runtime_error);
+
+	{
+		auto producer = shared_memory_ring_buffer::create(name, 100, 2);
+		EXPECT_THROW(shared_memory_ring_buffer::create(name, 100, 2), std::runtime_error);
+
+		auto consumer = shared_memory_ring_buffer::open(name);
+		EXPECT_EQ(consumer.ring_buffer().frame_size(), 100);
+		EXPECT_EQ(consumer.ring_buffer().slot_count(), 2);
+
+		const std::vector<float> frame(100, 1.5f);
+		EXPECT_TRUE(producer.ring_buffer().try_write(frame.data()));
+
+		// Moving keeps the mapping.
+		auto moved_consumer = std::move(consumer);
+		const bfloat16_t* const view = moved_consumer.ring_buffer().try_begin_read();
+		ASSERT_NE(view, nullptr);
+		EXPECT_FLOAT_EQ(view[99], 1.5f);
+		moved_consumer.ring_buffer().end_read();
+	}
+	EXPECT_TRUE(shared_memory_ring_buffer::remove(name));
+	EXPECT_FALSE(shared_memory_ring_buffer::remove(name));
+}
+
+
+GTEST_TEST(bfloat16_ring_buffer, SharedMemoryStreamsBetweenProcesses)
+{
+	using biovault::shared_memory_ring_buffer;
+
+	constexpr std::size_t frame_size{ 513 };
+	constexpr std::size_t frame_count{ 2000 };
+
+	const auto name = unique_shared_memory_name("fork");
+	shared_memory_ring_buffer::remove(name);
+	auto consumer = shared_memory_ring_buffer::create(name, frame_size, 8);
+
+	const auto child_process_id = ::fork();
+	ASSERT_GE(child_process_id, 0);
+
+	if (child_process_id == 0)
+	{
+		// The child process is the producer, attaching by name.
+		int exit_code{ 1 };
+		try
+		{
+			auto producer = shared_memory_ring_buffer::open(name);
+			std::vector<float> frame(frame_size);
+
+			for (std::size_t frame_number{}; frame_number < frame_count; ++frame_number)
+			{
+				for (std::size_t i{}; i < frame_size; ++i)
+				{
+					frame[i] = frame_value(frame_number, i);
+				}
+				while (!producer.ring_buffer().try_write(frame.data()))
+				{
+					std::this_thread::yield();
+				}
+			}
+			exit_code = 0;
+		}
+		catch (...)
+		{
+		}
+		::_exit(exit_code);
+	}
+
+	std::size_t mismatch_count{};
+	std::size_t received_frame_count{};
+	int status{};
+	bool has_exited{};
+
+	for (std::size_t frame_number{}; frame_number < frame_count; ++frame_number)
+	{
+		const bfloat16_t* frame;
+
+		while ((frame = consumer.ring_buffer().try_begin_read()) == nullptr)
+		{
+			// Stop waiting when the producer has exited, for example because it failed to open the buffer.
+			// It may still have committed frames just before exiting, so try once more.
+			if (has_exited || (::waitpid(child_process_id, &status, WNOHANG) == child_process_id))
+			{
+				has_exited = true;
+				frame = consumer.ring_buffer().try_begin_read();
+				break;
+			}
+			std::this_thread::yield();
+		}
+		if (frame == nullptr)
+		{
+			break;
+		}
+		++received_frame_count;
+
+		for (std::size_t i{}; i < frame_size; ++i)
+		{
+			if (biovault::get_raw_bits(frame[i]) != biovault::get_raw_bits(bfloat16_t(frame_value(frame_number, i))))
+			{
+				++mismatch_count;
+			}
+		}
+		consumer.ring_buffer().end_read();
+	}
+	if (!has_exited)
+	{
+		EXPECT_EQ(::waitpid(child_process_id, &status, 0), child_process_id);
+	}
+	EXPECT_TRUE(WIFEXITED(status) && (WEXITSTATUS(status) == 0));
+	EXPECT_EQ(received_frame_count, frame_count);
+	EXPECT_EQ(mismatch_count, 0);
+	EXPECT_TRUE(shared_memory_ring_buffer::remove(name));
+}
+
+#endif
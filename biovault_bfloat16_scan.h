@@ -0,0 +1,325 @@
+#ifndef BIOVAULT_BFLOAT16_SCAN_H_INCLUDE_GUARD
+#define BIOVAULT_BFLOAT16_SCAN_H_INCLUDE_GUARD
+
+/*******************************************************************************
+* Copyright 2020 LKEB, Leiden University Medical Center
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*******************************************************************************/
+
+// Prefix sums (inclusive and exclusive scans, also per segment) of bfloat16_t
+// arrays, and integral images of bfloat16_t images. The running sum is carried
+// as a float, and the output may be float or bfloat16_t. (Accumulating in a
+// bfloat16_t, by operator+=, would stop growing as soon as the sum is 256 times
+// larger than the elements.)
+//
+// The scans are multithreaded, in two passes: each thread first sums its range
+// of the input, and then scans it, starting from the sum of all the preceding
+// ranges. Within a thread, the scan is done by SSE2 or AVX2 (when enabled), so
+// the order of the additions (and therefore the rounding) may differ slightly
+// from a sequential loop.
+
+#include "biovault_bfloat16.h"
+#include "biovault_bfloat16_bulk.h"
+#include "biovault_bfloat16_parallel.h"
+
+#include <algorithm> // For is_sorted, lower_bound, max, min, and upper_bound.
+#include <cstddef>   // For size_t.
+#include <cstring>   // For memcpy.
+#include <stdexcept> // For invalid_argument.
+#include <vector>
+
+namespace biovault {
+
+	namespace scan_detail {
+
+		// Scans the elements in [0, size), starting from the specified carry (the
+		// sum of the preceding elements). Returns the carry for the next element.
+		inline float scan_block(const bfloat16_t* const src, float* const dst, const std::size_t size, float carry, const bool exclusive) {
+			std::size_t i{};
+#if defined(BIOVAULT_BFLOAT16_HAS_AVX2)
+			const __m256i zero = _mm256_setzero_si256();
+			const __m256i shift_one_element = _mm256_setr_epi32(0, 0, 1, 2, 3, 4, 5, 6);
+			__m256 carry8 = _mm256_set1_ps(carry);
+
+			for (; i + 8 <= size; i += 8) {
+				__m256 x = _mm256_castsi256_ps(_mm256_slli_epi32(
+					_mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i))), 16));
+				const __m256 input = x;
+
+				if (exclusive) {
+					x = _mm256_blend_ps(_mm256_permutevar8x32_ps(x, shift_one_element), _mm256_castsi256_ps(zero), 0x01);
+				}
+				// Prefix sums within each 128-bit lane, and then across the lanes.
+				x = _mm256_add_ps(x, _mm256_castsi256_ps(_mm256_slli_si256(_mm256_castps_si256(x), 4)));
+				x = _mm256_add_ps(x, _mm256_castsi256_ps(_mm256_slli_si256(_mm256_castps_si256(x), 8)));
+				const __m256 lane_totals = _mm256_shuffle_ps(x, x, 0xFF);
+				x = _mm256_add_ps(x, _mm256_permute2f128_ps(lane_totals, lane_totals, 0x08));
+
+				const __m256 sums = _mm256_add_ps(x, carry8);
+				_mm256_storeu_ps(dst + i, sums);
+				carry8 = _mm256_permutevar8x32_ps(exclusive ? _mm256_add_ps(sums, input) : sums, _mm256_set1_epi32(7));
+			}
+			carry = _mm256_cvtss_f32(carry8);
+#elif defined(BIOVAULT_BFLOAT16_HAS_SSE2)
+			__m128 carry4 = _mm_set1_ps(carry);
+
+			for (; i + 4 <= size; i += 4) {
+				const __m128 input = _mm_castsi128_ps(_mm_unpacklo_epi16(_mm_setzero_si128(),
+					_mm_loadl_epi64(reinterpret_cast<const __m128i*>(src + i))));
+				__m128 x = exclusive ? _mm_castsi128_ps(_mm_slli_si128(_mm_castps_si128(input), 4)) : input;
+				x = _mm_add_ps(x, _mm_castsi128_ps(_mm_slli_si128(_mm_castps_si128(x), 4)));
+				x = _mm_add_ps(x, _mm_castsi128_ps(_mm_slli_si128(_mm_castps_si128(x), 8)));
+
+				const __m128 sums = _mm_add_ps(x, carry4);
+				_mm_storeu_ps(dst + i, sums);
+				const __m128 next = exclusive ? _mm_add_ps(sums, input) : sums;
+				carry4 = _mm_shuffle_ps(next, next, 0xFF);
+			}
+			carry = _mm_cvtss_f32(carry4);
+#endif
+			for (; i < size; ++i) {
+				const float value{ src[i] };
+
+				if (exclusive) {
+					dst[i] = carry;
+					carry += value;
+				}
+				else {
+					carry += value;
+					dst[i] = carry;
+				}
+			}
+			return carry;
+		}
+
+		inline float scan(const bfloat16_t* const src, float* const dst, const std::size_t size, const float carry, const bool exclusive) {
+			return scan_block(src, dst, size, carry, exclusive);
+		}
+
+		// Scans block by block into a float buffer in the L1 cache, and narrows each block.
+		inline float scan(const bfloat16_t* const src, bfloat16_t* const dst, const std::size_t size, float carry, const bool exclusive) {
+			float block[kernels::fused_block_size];
+
+			for (std::size_t i{}; i < size; i += kernels::fused_block_size) {
+				const auto block_size = std::min(kernels::fused_block_size, size - i);
+				carry = scan_block(src + i, block, block_size, carry, exclusive);
+				kernels::native::convert_float_to_bfloat16(block, dst + i, block_size);
+			}
+			return carry;
+		}
+
+		inline float sum(const bfloat16_t* const src, const std::size_t size) {
+			float block[kernels::fused_block_size];
+			float result{};
+
+			for (std::size_t i{}; i < size; i += kernels::fused_block_size) {
+				const auto block_size = std::min(kernels::fused_block_size, size - i);
+				kernels::native::convert_bfloat16_to_float(src + i, block, block_size);
+
+				// Eight independent partial sums, which the compiler may vectorize.
+				float partial_sums[8]{};
+				std::size_t j{};
+
+				for (; j + 8 <= block_size; j += 8) {
+					for (std::size_t k{}; k < 8; ++k) {
+						partial_sums[k] += block[j + k];
+					}
+				}
+				for (; j < block_size; ++j) {
+					result += block[j];
+				}
+				for (const auto partial_sum : partial_sums) {
+					result += partial_sum;
+				}
+			}
+			return result;
+		}
+
+		// Scans the segments that start at the specified (sorted) offsets, each
+		// starting from initial_value. The elements before the first segment start
+		// (if any) are treated as a continuation of a preceding segment.
+		template <typename OutputType>
+		void segmented_scan(const bfloat16_t* const src, OutputType* const dst, const std::size_t size,
+			const std::size_t* const segment_starts, const std::size_t segment_count,
+			const float initial_value, const bool exclusive, unsigned thread_count) {
+			if (thread_count == 0) {
+				thread_count = default_thread_count();
+			}
+			const auto starts_end = segment_starts + segment_count;
+
+			// Scans [begin, end), where 'carry' applies to the part before the first segment start.
+			const auto scan_range = [=](const std::size_t begin, const std::size_t end, float carry) {
+				auto position = begin;
+
+				for (auto start = std::lower_bound(segment_starts, starts_end, begin); (start != starts_end) && (*start < end); ++start) {
+					scan(src + position, dst + position, *start - position, carry, exclusive);
+					position = *start;
+					carry = initial_value;
+				}
+				scan(src + position, dst + position, end - position, carry, exclusive);
+			};
+
+			const auto range_count = std::max<std::size_t>(1,
+				std::min<std::size_t>(thread_count, size / parallel_conversion_min_range_size));
+
+			if (range_count == 1) {
+				scan_range(0, size, initial_value);
+				return;
+			}
+
+			// Pass 1: the sum of each range after its last segment start, and whether it contains a segment start.
+			std::vector<float> tail_sums(range_count);
+			std::vector<char> has_segment_start(range_count);
+
+			parallel_for_ranges(size, static_cast<unsigned>(range_count),
+				[&](const std::size_t begin, const std::size_t end, const std::size_t range_index) {
+				const auto last_start = std::upper_bound(segment_starts, starts_end, end - 1);
+				const bool has_start = (last_start != segment_starts) && (*(last_start - 1) >= begin);
+				const auto tail_begin = has_start ? *(last_start - 1) : begin;
+				tail_sums[range_index] = sum(src + tail_begin, end - tail_begin);
+				has_segment_start[range_index] = has_start;
+			}, parallel_conversion_min_range_size);
+
+			// The carry into each range.
+			std::vector<float> carries(range_count);
+			carries[0] = initial_value;
+
+			for (std::size_t i{ 1 }; i < range_count; ++i) {
+				carries[i] = (has_segment_start[i - 1] ? initial_value : carries[i - 1]) + tail_sums[i - 1];
+			}
+
+			// Pass 2: scan each range, starting from its carry.
+			parallel_for_ranges(size, static_cast<unsigned>(range_count),
+				[&](const std::size_t begin, const std::size_t end, const std::size_t range_index) {
+				scan_range(begin, end, carries[range_index]);
+			}, parallel_conversion_min_range_size);
+		}
+
+		template <typename OutputType>
+		void segmented_scan(const bfloat16_t* const src, OutputType* const dst, const std::vector<std::size_t>& segment_offsets,
+			const float initial_value, const bool exclusive, const unsigned thread_count) {
+			if (segment_offsets.empty() || (segment_offsets.front() != 0) ||
+				!std::is_sorted(segment_offsets.cbegin(), segment_offsets.cend())) {
+				throw std::invalid_argument("segmented scan: the segment offsets must start at zero, and be non-decreasing");
+			}
+			segmented_scan(src, dst, segment_offsets.back(), segment_offsets.data(), segment_offsets.size() - 1,
+				initial_value, exclusive, thread_count);
+		}
+
+		inline void narrow(const float* const src, float* const dst, const std::size_t size) {
+			std::memcpy(dst, src, size * sizeof(float));
+		}
+
+		inline void narrow(const float* const src, bfloat16_t* const dst, const std::size_t size) {
+			kernels::native::convert_float_to_bfloat16(src, dst, size);
+		}
+
+		// Minimum number of columns of a vertical strip of an integral image, processed by one thread.
+		constexpr std::size_t min_strip_width{ 256 };
+	}
+
+
+	// dst[i] = src[0] + ... + src[i], for i in [0, size). The output may be
+	// float or bfloat16_t (rounded from the float running sum).
+	template <typename OutputType>
+	void inclusive_scan(const bfloat16_t* const src, OutputType* const dst, const std::size_t size, const unsigned thread_count = 0)
+	{
+		const std::size_t start{};
+		scan_detail::segmented_scan(src, dst, size, &start, 1, 0.0f, false, thread_count);
+	}
+
+	// dst[i] = initial_value + src[0] + ... + src[i - 1], for i in [0, size).
+	template <typename OutputType>
+	void exclusive_scan(const bfloat16_t* const src, OutputType* const dst, const std::size_t size,
+		const float initial_value = 0.0f, const unsigned thread_count = 0)
+	{
+		const std::size_t start{};
+		scan_detail::segmented_scan(src, dst, size, &start, 1, initial_value, true, thread_count);
+	}
+
+	// Scans each segment [segment_offsets[j], segment_offsets[j + 1]) separately
+	// (inclusive). The offsets must start at zero and be non-decreasing; the last
+	// offset is the number of elements. Throws std::invalid_argument otherwise.
+	template <typename OutputType>
+	void segmented_inclusive_scan(const bfloat16_t* const src, OutputType* const dst, const std::vector<std::size_t>& segment_offsets,
+		const unsigned thread_count = 0)
+	{
+		scan_detail::segmented_scan(src, dst, segment_offsets, 0.0f, false, thread_count);
+	}
+
+	// Scans each segment separately (exclusive), each starting from initial_value.
+	template <typename OutputType>
+	void segmented_exclusive_scan(const bfloat16_t* const src, OutputType* const dst, const std::vector<std::size_t>& segment_offsets,
+		const float initial_value = 0.0f, const unsigned thread_count = 0)
+	{
+		scan_detail::segmented_scan(src, dst, segment_offsets, initial_value, true, thread_count);
+	}
+
+	// Computes the (inclusive) integral image of a width x height image, stored
+	// row by row: dst(x, y) is the sum of src(i, j) for all i <= x and j <= y.
+	// The image is split into vertical strips, one per thread. Each thread keeps
+	// the float column sums of its strip, so that no float copy of the whole
+	// image is needed for a bfloat16_t output.
+	template <typename OutputType>
+	void integral_image(const bfloat16_t* const src, OutputType* const dst, const std::size_t width, const std::size_t height,
+		unsigned thread_count = 0)
+	{
+		if (thread_count == 0) {
+			thread_count = default_thread_count();
+		}
+		const auto strip_count = std::max<std::size_t>(1, std::min<std::size_t>(thread_count, width / scan_detail::min_strip_width));
+		const auto strip_begin = [width, strip_count](const std::size_t strip_index) {
+			return width * strip_index / strip_count;
+		};
+
+		// The sum of the elements to the left of each strip, for each row.
+		std::vector<float> row_offsets(strip_count > 1 ? (height * strip_count) : 0);
+
+		if (strip_count > 1) {
+			parallel_for_ranges(height, thread_count, [&](const std::size_t row_begin, const std::size_t row_end, std::size_t) {
+				for (auto row = row_begin; row < row_end; ++row) {
+					float offset{};
+
+					for (std::size_t strip_index{}; strip_index < strip_count; ++strip_index) {
+						row_offsets[row * strip_count + strip_index] = offset;
+						offset += scan_detail::sum(src + row * width + strip_begin(strip_index),
+							strip_begin(strip_index + 1) - strip_begin(strip_index));
+					}
+				}
+			});
+		}
+
+		parallel_for_ranges(strip_count, static_cast<unsigned>(strip_count),
+			[&](const std::size_t first_strip, const std::size_t last_strip, std::size_t) {
+			for (auto strip_index = first_strip; strip_index < last_strip; ++strip_index) {
+				const auto column_begin = strip_begin(strip_index);
+				const auto strip_width = strip_begin(strip_index + 1) - column_begin;
+				std::vector<float> row_sums(strip_width);
+				std::vector<float> column_sums(strip_width);
+
+				for (std::size_t row{}; row < height; ++row) {
+					scan_detail::scan_block(src + row * width + column_begin, row_sums.data(), strip_width,
+						(strip_count > 1) ? row_offsets[row * strip_count + strip_index] : 0.0f, false);
+
+					for (std::size_t column{}; column < strip_width; ++column) {
+						column_sums[column] += row_sums[column];
+					}
+					scan_detail::narrow(column_sums.data(), dst + row * width + column_begin, strip_width);
+				}
+			}
+		});
+	}
+}
+
+#endif
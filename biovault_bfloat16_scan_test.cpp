@@ -0,0 +1,265 @@
+/*******************************************************************************
+* Copyright 2020 LKEB, Leiden University Medical Center
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*******************************************************************************/
+
+// The file to be tested. Included twice here, to check its include guards!
+#include "biovault_bfloat16_scan.h"
+#include "biovault_bfloat16_scan.h"
+
+// GoogleTest header file:
+#include <gtest/gtest.h>
+
+// Standard library header files:
+#include <cstddef>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+
+namespace
+{
+	using biovault::bfloat16_t;
+
+	// Larger than two parallel ranges, and not a multiple of the SIMD width.
+	constexpr std::size_t large_size{ 300001 };
+
+
+	// Multiples of 0.25 in [-8, 8], so that all sums (up to 2^24 quarters) are
+	// exact in float, regardless of the order of the additions.
+	std::vector<bfloat16_t> make_values(const std::size_t size)
+	{
+		std::mt19937 generator;
+		std::uniform_int_distribution<int> distribution(-32, 32);
+		std::vector<bfloat16_t> result;
+		result.reserve(size);
+
+		for (std::size_t i{}; i < size; ++i)
+		{
+			result.emplace_back(static_cast<float>(distribution(generator)) / 4.0f);
+		}
+		return result;
+	}
+
+
+	// Straightforward reference implementation, scanning each segment separately.
+	std::vector<double> scan_segments(const std::vector<bfloat16_t>& values, const std::vector<std::size_t>& segment_offsets,
+		const bool exclusive, const double initial_value)
+	{
+		std::vector<double> result(values.size());
+
+		for (std::size_t segment{}; segment + 1 < segment_offsets.size(); ++segment)
+		{
+			double sum{ initial_value };
+
+			for (auto i = segment_offsets[segment]; i < segment_offsets[segment + 1]; ++i)
+			{
+				if (exclusive)
+				{
+					result[i] = sum;
+					sum += values[i];
+				}
+				else
+				{
+					sum += values[i];
+					result[i] = sum;
+				}
+			}
+		}
+		return result;
+	}
+
+
+	void expect_equal(const std::vector<float>& actual, const std::vector<double>& expected)
+	{
+		ASSERT_EQ(actual.size(), expected.size());
+
+		for (std::size_t i{}; i < actual.size(); ++i)
+		{
+			ASSERT_FLOAT_EQ(actual[i], static_cast<float>(expected[i])) << "i = " << i;
+		}
+	}
+
+
+	// Expects each element to be the (exact) expected sum, rounded to bfloat16.
+	void expect_equal(const std::vector<bfloat16_t>& actual, const std::vector<double>& expected)
+	{
+		ASSERT_EQ(actual.size(), expected.size());
+
+		for (std::size_t i{}; i < actual.size(); ++i)
+		{
+			ASSERT_EQ(biovault::get_raw_bits(actual[i]), biovault::get_raw_bits(bfloat16_t(static_cast<float>(expected[i]))))
+				<< "i = " << i;
+		}
+	}
+
+}
+
+
+GTEST_TEST(bfloat16_scan, InclusiveScan)
+{
+	for (const std::size_t size : { std::size_t{ 0 }, std::size_t{ 1 }, std::size_t{ 7 }, std::size_t{ 8 }, std::size_t{ 9 },
+		std::size_t{ 5000 }, large_size })
+	{
+		const auto values = make_values(size);
+		const auto expected = scan_segments(values, { 0, size }, false, 0.0);
+
+		for (const unsigned thread_count : { 1, 3 })
+		{
+			std::vector<float> float_result(size);
+			biovault::inclusive_scan(values.data(), float_result.data(), size, thread_count);
+			expect_equal(float_result, expected);
+
+			std::vector<bfloat16_t> bfloat16_result(size);
+			biovault::inclusive_scan(values.data(), bfloat16_result.data(), size, thread_count);
+			expect_equal(bfloat16_result, expected);
+		}
+	}
+}
+
+
+GTEST_TEST(bfloat16_scan, ExclusiveScan)
+{
+	for (const std::size_t size : { std::size_t{ 1 }, std::size_t{ 13 }, large_size })
+	{
+		const auto values = make_values(size);
+		const auto expected = scan_segments(values, { 0, size }, true, 2.5);
+
+		for (const unsigned thread_count : { 1, 3 })
+		{
+			std::vector<float> float_result(size);
+			biovault::exclusive_scan(values.data(), float_result.data(), size, 2.5f, thread_count);
+			expect_equal(float_result, expected);
+
+			std::vector<bfloat16_t> bfloat16_result(size);
+			biovault::exclusive_scan(values.data(), bfloat16_result.data(), size, 2.5f, thread_count);
+			expect_equal(bfloat16_result, expected);
+		}
+	}
+}
+
+
+GTEST_TEST(bfloat16_scan, CarriesInFloatRatherThanBfloat16)
+{
+	constexpr std::size_t size{ 100000 };
+	const std::vector<bfloat16_t> ones(size, bfloat16_t(1.0f));
+
+	// Accumulating in bfloat16_t gets stuck at 256, as 256 + 1 rounds to 256.
+	bfloat16_t bfloat16_sum{};
+
+	for (const auto one : ones)
+	{
+		bfloat16_sum += one;
+	}
+	EXPECT_FLOAT_EQ(bfloat16_sum, 256.0f);
+
+	std::vector<float> float_result(size);
+	biovault::inclusive_scan(ones.data(), float_result.data(), size);
+	EXPECT_FLOAT_EQ(float_result.back(), 100000.0f);
+
+	std::vector<bfloat16_t> bfloat16_result(size);
+	biovault::inclusive_scan(ones.data(), bfloat16_result.data(), size);
+	EXPECT_EQ(biovault::get_raw_bits(bfloat16_result.back()), biovault::get_raw_bits(bfloat16_t(100000.0f)));
+}
+
+
+GTEST_TEST(bfloat16_scan, SegmentedScan)
+{
+	const auto values = make_values(large_size);
+
+	// Short and long segments, including empty ones, and one segment that spans
+	// multiple parallel ranges.
+	std::vector<std::size_t> segment_offsets{ 0, 0, 1, 9, 9, 1000, 150000 };
+	std::mt19937 generator;
+	std::uniform_int_distribution<std::size_t> distribution(1, 20000);
+
+	while (segment_offsets.back() + 20000 < large_size)
+	{
+		segment_offsets.push_back(segment_offsets.back() + distribution(generator));
+	}
+	segment_offsets.push_back(large_size);
+
+	for (const bool exclusive : { false, true })
+	{
+		const double initial_value{ exclusive ? 1.0 : 0.0 };
+		const auto expected = scan_segments(values, segment_offsets, exclusive, initial_value);
+
+		for (const unsigned thread_count : { 1, 3, 4 })
+		{
+			std::vector<float> float_result(large_size);
+			std::vector<bfloat16_t> bfloat16_result(large_size);
+
+			if (exclusive)
+			{
+				biovault::segmented_exclusive_scan(values.data(), float_result.data(), segment_offsets, 1.0f, thread_count);
+				biovault::segmented_exclusive_scan(values.data(), bfloat16_result.data(), segment_offsets, 1.0f, thread_count);
+			}
+			else
+			{
+				biovault::segmented_inclusive_scan(values.data(), float_result.data(), segment_offsets, thread_count);
+				biovault::segmented_inclusive_scan(values.data(), bfloat16_result.data(), segment_offsets, thread_count);
+			}
+			expect_equal(float_result, expected);
+			expect_equal(bfloat16_result, expected);
+		}
+	}
+}
+
+
+GTEST_TEST(bfloat16_scan, ThrowsOnInvalidSegmentOffsets)
+{
+	const auto values = make_values(10);
+	std::vector<float> result(values.size());
+
+	for (const auto& segment_offsets : { std::vector<std::size_t>{}, std::vector<std::size_t>{ 1, 10 }, std::vector<std::size_t>{ 0, 5, 4, 10 } })
+	{
+		EXPECT_THROW(biovault::segmented_inclusive_scan(values.data(), result.data(), segment_offsets), std::invalid_argument);
+		EXPECT_THROW(biovault::segmented_exclusive_scan(values.data(), result.data(), segment_offsets), std::invalid_argument);
+	}
+}
+
+
+GTEST_TEST(bfloat16_scan, IntegralImage)
+{
+	constexpr std::size_t height{ 37 };
+
+	// Narrower than a strip, and wide enough for multiple strips.
+	for (const std::size_t width : { 1, 5, 1000 })
+	{
+		const auto image = make_values(width * height);
+		std::vector<double> expected(image.size());
+
+		for (std::size_t y{}; y < height; ++y)
+		{
+			for (std::size_t x{}; x < width; ++x)
+			{
+				expected[y * width + x] = double{ image[y * width + x] } +
+					((x > 0) ? expected[y * width + x - 1] : 0.0) +
+					((y > 0) ? expected[(y - 1) * width + x] : 0.0) -
+					(((x > 0) && (y > 0)) ? expected[(y - 1) * width + x - 1] : 0.0);
+			}
+		}
+
+		for (const unsigned thread_count : { 1, 3 })
+		{
+			std::vector<float> float_result(image.size());
+			biovault::integral_image(image.data(), float_result.data(), width, height, thread_count);
+			expect_equal(float_result, expected);
+
+			std::vector<bfloat16_t> bfloat16_result(image.size());
+			biovault::integral_image(image.data(), bfloat16_result.data(), width, height, thread_count);
+			expect_equal(bfloat16_result, expected);
+		}
+	}
+}
@@ -0,0 +1,87 @@
+#ifndef BIOVAULT_BFLOAT16_STATISTICS_H_INCLUDE_GUARD
+#define BIOVAULT_BFLOAT16_STATISTICS_H_INCLUDE_GUARD
+
+/*******************************************************************************
+* Copyright 2020 LKEB, Leiden University Medical Center
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*******************************************************************************/
+
+// Opt-in instrumentation of the bulk conversion from float to bfloat16_t:
+// counts the values that overflow to infinity, the subnormals that are flushed
+// to zero, the signaling NaNs that are quieted, and keeps a histogram of the
+// relative rounding error.
+//
+// The instrumentation is only compiled in when the macro
+// BIOVAULT_BFLOAT16_CONVERSION_STATISTICS is defined (consistently, for all
+// translation units of a program). Otherwise, the overloads that take a
+// conversion_statistics argument just convert, and leave the statistics
+// untouched, so that the calling code does not need to be adjusted. (The
+// instrumented kernel itself is in biovault_bfloat16_statistics_kernels.h,
+// which does not depend on the macro.)
+
+#include "biovault_bfloat16_bulk.h"
+#include "biovault_bfloat16_parallel.h"
+#include "biovault_bfloat16_statistics_kernels.h"
+
+#include <cstddef>   // For size_t.
+#include <vector>
+
+namespace biovault {
+
+#ifdef BIOVAULT_BFLOAT16_CONVERSION_STATISTICS
+	constexpr bool conversion_statistics_enabled{ true };
+#else
+	constexpr bool conversion_statistics_enabled{ false };
+#endif
+
+	// Converts 'size' floats to bfloat16, and adds the statistics of the conversion
+	// to the specified statistics (only when BIOVAULT_BFLOAT16_CONVERSION_STATISTICS
+	// is defined).
+	inline void convert_float_to_bfloat16(const float* const src, bfloat16_t* const dst, const std::size_t size,
+		conversion_statistics& statistics)
+	{
+#ifdef BIOVAULT_BFLOAT16_CONVERSION_STATISTICS
+		kernels::convert_float_to_bfloat16_instrumented(src, dst, size, statistics);
+#else
+		static_cast<void>(statistics);
+		convert_float_to_bfloat16(src, dst, size);
+#endif
+	}
+
+	// Multithreaded version of the instrumented conversion. Each thread records its
+	// own statistics, which are merged into the specified statistics afterwards.
+	inline void parallel_convert_float_to_bfloat16(const float* const src, bfloat16_t* const dst, const std::size_t size,
+		conversion_statistics& statistics, const unsigned thread_count = 0)
+	{
+#ifdef BIOVAULT_BFLOAT16_CONVERSION_STATISTICS
+		std::vector<conversion_statistics> per_thread_statistics((thread_count == 0) ? default_thread_count() : thread_count);
+
+		parallel_for_ranges(size, thread_count,
+			[src, dst, &per_thread_statistics](const std::size_t begin, const std::size_t end, const std::size_t range_index) {
+			conversion_statistics local_statistics;
+			kernels::convert_float_to_bfloat16_instrumented(src + begin, dst + begin, end - begin, local_statistics);
+			per_thread_statistics[range_index] = local_statistics;
+		}, parallel_conversion_min_range_size);
+
+		for (const auto& thread_statistics : per_thread_statistics) {
+			statistics += thread_statistics;
+		}
+#else
+		static_cast<void>(statistics);
+		parallel_convert_float_to_bfloat16(src, dst, size, thread_count);
+#endif
+	}
+}
+
+#endif
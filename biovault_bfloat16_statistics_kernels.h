@@ -0,0 +1,141 @@
+#ifndef BIOVAULT_BFLOAT16_STATISTICS_KERNELS_H_INCLUDE_GUARD
+#define BIOVAULT_BFLOAT16_STATISTICS_KERNELS_H_INCLUDE_GUARD
+
+/*******************************************************************************
+* Copyright 2020 LKEB, Leiden University Medical Center
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*******************************************************************************/
+
+// The instrumented conversion kernel of biovault_bfloat16_statistics.h, and the
+// statistics it records. Unlike biovault_bfloat16_statistics.h, this header does
+// not depend on the macro BIOVAULT_BFLOAT16_CONVERSION_STATISTICS, so it may be
+// included by any translation unit (for example, to verify or benchmark the
+// instrumented kernel), without violating the one definition rule.
+
+#include "biovault_bfloat16.h"
+#include "biovault_bfloat16_bulk.h"
+
+#include <algorithm> // For min and max.
+#include <array>
+#include <cmath>     // For fabs and ilogb.
+#include <cstddef>   // For size_t.
+#include <cstdint>   // For uint32_t.
+#include <cstring>   // For memcpy.
+
+namespace biovault {
+
+	// Number of bins of conversion_statistics::relative_error_histogram. Bin 0
+	// counts the exact conversions of normal floats, and bin i (for i > 0) the
+	// relative errors in [2^-(8+i), 2^-(7+i)). (Rounding to nearest even keeps
+	// the relative error of a normal float below 2^-8, and an inexact
+	// conversion has a relative error of at least 2^-24.)
+	constexpr std::size_t relative_error_histogram_bin_count{ 17 };
+
+	struct conversion_statistics {
+		std::size_t element_count{};
+
+		// Finite floats that were converted to infinity.
+		std::size_t overflow_count{};
+
+		// Non-zero subnormal floats that were flushed to (signed) zero.
+		std::size_t flush_to_zero_count{};
+
+		std::size_t nan_count{};
+
+		// Signaling NaNs that were converted to quiet NaNs.
+		std::size_t quieted_nan_count{};
+
+		// Normal floats that were rounded to a different (finite) value.
+		std::size_t inexact_count{};
+
+		double max_relative_error{};
+
+		std::array<std::size_t, relative_error_histogram_bin_count> relative_error_histogram{};
+
+		conversion_statistics& operator+=(const conversion_statistics& other) {
+			element_count += other.element_count;
+			overflow_count += other.overflow_count;
+			flush_to_zero_count += other.flush_to_zero_count;
+			nan_count += other.nan_count;
+			quieted_nan_count += other.quieted_nan_count;
+			inexact_count += other.inexact_count;
+			max_relative_error = std::max(max_relative_error, other.max_relative_error);
+
+			for (std::size_t i{}; i < relative_error_histogram_bin_count; ++i) {
+				relative_error_histogram[i] += other.relative_error_histogram[i];
+			}
+			return *this;
+		}
+	};
+
+	namespace kernels {
+
+		// Adds the statistics of the conversion of 'src' to 'dst' (which must
+		// already be converted) to the specified statistics.
+		inline void record_conversion_statistics(const float* const src, const bfloat16_t* const dst, const std::size_t size,
+			conversion_statistics& statistics) {
+			statistics.element_count += size;
+
+			for (std::size_t i{}; i < size; ++i) {
+				std::uint32_t bits;
+				std::memcpy(&bits, src + i, sizeof(bits));
+				const std::uint32_t abs_bits{ bits & 0x7FFFFFFFU };
+
+				if (abs_bits > 0x7F800000U) {
+					++statistics.nan_count;
+
+					if ((bits & 0x00400000U) == 0) {
+						++statistics.quieted_nan_count;
+					}
+				}
+				else if ((abs_bits == 0x7F800000U) || (abs_bits == 0)) {
+					// Infinity and zero are converted exactly.
+				}
+				else if (abs_bits < 0x00800000U) {
+					++statistics.flush_to_zero_count;
+				}
+				else if ((get_raw_bits(dst[i]) & 0x7FFFU) == 0x7F80U) {
+					++statistics.overflow_count;
+				}
+				else if ((bits & 0xFFFFU) == 0) {
+					++statistics.relative_error_histogram[0];
+				}
+				else {
+					++statistics.inexact_count;
+					const double value{ src[i] };
+					const double relative_error{ std::fabs((double{ float{ dst[i] } } - value) / value) };
+					const auto bin = std::min<int>(
+						std::max<int>(-std::ilogb(relative_error) - 8, 1),
+						static_cast<int>(relative_error_histogram_bin_count) - 1);
+					++statistics.relative_error_histogram[static_cast<std::size_t>(bin)];
+					statistics.max_relative_error = std::max(statistics.max_relative_error, relative_error);
+				}
+			}
+		}
+
+		// Converts block by block, recording the statistics of each block while
+		// it is still in the L1 cache.
+		inline void convert_float_to_bfloat16_instrumented(const float* const src, bfloat16_t* const dst, const std::size_t size,
+			conversion_statistics& statistics) {
+			for (std::size_t i{}; i < size; i += fused_block_size) {
+				const auto block_size = std::min(fused_block_size, size - i);
+				native::convert_float_to_bfloat16(src + i, dst + i, block_size);
+				record_conversion_statistics(src + i, dst + i, block_size, statistics);
+			}
+		}
+	}
+
+}
+
+#endif
@@ -0,0 +1,157 @@
+/*******************************************************************************
+* Copyright 2020 LKEB, Leiden University Medical Center
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*******************************************************************************/
+
+// Enable the instrumentation to be tested. (No other translation unit of the
+// test program includes biovault_bfloat16_statistics.h. The verification test
+// only includes the macro-independent biovault_bfloat16_statistics_kernels.h.)
+#define BIOVAULT_BFLOAT16_CONVERSION_STATISTICS
+
+// The file to be tested. Included twice here, to check its include guards!
+#include "biovault_bfloat16_statistics.h"
+#include "biovault_bfloat16_statistics.h"
+
+// GoogleTest header file:
+#include <gtest/gtest.h>
+
+// Standard library header files:
+#include <algorithm> // For count_if.
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <numeric> // For accumulate.
+#include <vector>
+
+
+namespace
+{
+	using biovault::bfloat16_t;
+	using biovault::conversion_statistics;
+
+	using float_limits = std::numeric_limits<float>;
+
+	static_assert(biovault::conversion_statistics_enabled, "The instrumentation should be enabled by the macro");
+
+
+	float bits_to_float(const std::uint32_t arg)
+	{
+		float result;
+		std::memcpy(&result, &arg, sizeof(arg));
+		return result;
+	}
+
+
+	std::size_t histogram_total(const conversion_statistics& statistics)
+	{
+		return std::accumulate(statistics.relative_error_histogram.cbegin(), statistics.relative_error_histogram.cend(), std::size_t{});
+	}
+
+
+	conversion_statistics convert(const std::vector<float>& floats)
+	{
+		std::vector<bfloat16_t> bfloat16_values(floats.size());
+		conversion_statistics statistics;
+		biovault::convert_float_to_bfloat16(floats.data(), bfloat16_values.data(), floats.size(), statistics);
+		return statistics;
+	}
+}
+
+
+GTEST_TEST(bfloat16_statistics, CountsOverflowFlushToZeroAndQuietedNan)
+{
+	const auto statistics = convert(
+		{
+			float_limits::max(),
+			float_limits::lowest(),
+			float_limits::infinity(),
+			float_limits::denorm_min(),
+			-float_limits::min() / 2.0f,
+			0.0f,
+			float_limits::quiet_NaN(),
+			float_limits::signaling_NaN(),
+			bits_to_float(0xFFA00001U), // A negative signaling NaN.
+			1.0f
+		});
+
+	EXPECT_EQ(statistics.element_count, 10U);
+	EXPECT_EQ(statistics.overflow_count, 2U);
+	EXPECT_EQ(statistics.flush_to_zero_count, 2U);
+	EXPECT_EQ(statistics.nan_count, 3U);
+	EXPECT_EQ(statistics.quieted_nan_count, 2U);
+	EXPECT_EQ(statistics.inexact_count, 0U);
+	EXPECT_EQ(statistics.relative_error_histogram[0], 1U);
+	EXPECT_EQ(histogram_total(statistics), 1U);
+}
+
+
+GTEST_TEST(bfloat16_statistics, RecordsRelativeErrorHistogram)
+{
+	// 1 + 2^-8 is a tie, rounded down to 1, with a relative error just below 2^-8.
+	// 1 + 2^-23 is rounded down to 1, with a relative error just below 2^-23 (in the last bin).
+	const auto statistics = convert({ 1.0f, 1.0f + std::ldexp(1.0f, -8), 1.0f + std::ldexp(1.0f, -23), -3.0f });
+
+	EXPECT_EQ(statistics.inexact_count, 2U);
+	EXPECT_EQ(statistics.relative_error_histogram[0], 2U);
+	EXPECT_EQ(statistics.relative_error_histogram[1], 1U);
+	EXPECT_EQ(statistics.relative_error_histogram[16], 1U);
+	EXPECT_EQ(histogram_total(statistics), 4U);
+	EXPECT_GT(statistics.max_relative_error, std::ldexp(1.0, -9));
+	EXPECT_LT(statistics.max_relative_error, std::ldexp(1.0, -8));
+}
+
+
+GTEST_TEST(bfloat16_statistics, ParallelStatisticsEqualSequentialStatistics)
+{
+	// Cover all exponents and a spread of mantissas, including all special values.
+	std::vector<float> floats;
+
+	for (std::uint32_t bits{}; bits < 0xFFFFFFFFU - 0x1357U; bits += 0x1357U)
+	{
+		floats.push_back(bits_to_float(bits));
+	}
+
+	const auto expected = convert(floats);
+
+	EXPECT_EQ(expected.element_count, floats.size());
+	EXPECT_EQ(expected.element_count,
+		expected.nan_count + expected.overflow_count + expected.flush_to_zero_count + histogram_total(expected) +
+		// Infinity and zero are not in the histogram:
+		static_cast<std::size_t>(std::count_if(floats.cbegin(), floats.cend(), [](const float f)
+	{
+		return std::isinf(f) || (std::fpclassify(f) == FP_ZERO);
+	})));
+	EXPECT_LT(expected.max_relative_error, std::ldexp(1.0, -8));
+
+	std::vector<bfloat16_t> bfloat16_values(floats.size());
+	conversion_statistics actual;
+
+	// Accumulates the statistics of two parallel conversions.
+	biovault::parallel_convert_float_to_bfloat16(floats.data(), bfloat16_values.data(), floats.size(), actual, 3);
+	biovault::parallel_convert_float_to_bfloat16(floats.data(), bfloat16_values.data(), floats.size(), actual, 4);
+
+	EXPECT_EQ(actual.element_count, 2 * expected.element_count);
+	EXPECT_EQ(actual.overflow_count, 2 * expected.overflow_count);
+	EXPECT_EQ(actual.flush_to_zero_count, 2 * expected.flush_to_zero_count);
+	EXPECT_EQ(actual.nan_count, 2 * expected.nan_count);
+	EXPECT_EQ(actual.quieted_nan_count, 2 * expected.quieted_nan_count);
+	EXPECT_EQ(actual.inexact_count, 2 * expected.inexact_count);
+	EXPECT_DOUBLE_EQ(actual.max_relative_error, expected.max_relative_error);
+
+	for (std::size_t i{}; i < biovault::relative_error_histogram_bin_count; ++i)
+	{
+		EXPECT_EQ(actual.relative_error_histogram[i], 2 * expected.relative_error_histogram[i]);
+	}
+}
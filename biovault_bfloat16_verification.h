@@ -0,0 +1,302 @@
+#ifndef BIOVAULT_BFLOAT16_VERIFICATION_H_INCLUDE_GUARD
+#define BIOVAULT_BFLOAT16_VERIFICATION_H_INCLUDE_GUARD
+
+/*******************************************************************************
+* Copyright 2020 LKEB, Leiden University Medical Center
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*******************************************************************************/
+
+// Verification of the bit-exactness of each conversion kernel against the
+// scalar reference: the bfloat16_t(float) constructor for conversion from float
+// (all 2^32 inputs) and from 32-bit integers (all 2^32 inputs), and the float
+// conversion operator for conversion to float (all 2^16 inputs).
+//
+// The sweep is multithreaded, and computes the reference only once per input,
+// for all kernels. A stride greater than one verifies a subset of the inputs,
+// for a quick check.
+
+#include "biovault_bfloat16.h"
+#include "biovault_bfloat16_bulk.h"
+#include "biovault_bfloat16_parallel.h"
+#include "biovault_bfloat16_statistics_kernels.h"
+
+#include <algorithm> // For min.
+#include <cstddef>   // For size_t.
+#include <cstdint>   // For uint16_t, uint32_t, and uint64_t.
+#include <cstring>   // For memcpy.
+#include <limits>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace biovault {
+
+	struct kernel_verification_result {
+		std::string isa;
+		std::string kernel_name;
+		std::uint64_t input_count{};
+		std::uint64_t mismatch_count{};
+
+		// The raw bits of the first input for which the kernel and the reference
+		// disagree (only meaningful when mismatch_count > 0).
+		std::uint64_t first_mismatch{};
+
+		bool passed() const {
+			return mismatch_count == 0;
+		}
+	};
+
+	namespace verification_detail {
+
+		using float_to_bfloat16_kernel = void(*)(const float*, bfloat16_t*, std::size_t);
+		using bfloat16_to_float_kernel = void(*)(const bfloat16_t*, float*, std::size_t);
+
+		template <typename Kernel>
+		struct kernel_entry {
+			const char* isa;
+			const char* name;
+			Kernel kernel;
+		};
+
+		// Number of inputs per block. Each thread converts a block by the
+		// reference, and then by each of the kernels.
+		constexpr std::size_t block_size{ std::size_t{ 1 } << 16U };
+
+		inline void convert_and_classify(const float* const src, bfloat16_t* const dst, const std::size_t size) {
+			static_cast<void>(convert_float_to_bfloat16_and_classify(src, dst, size));
+		}
+
+		inline void convert_instrumented(const float* const src, bfloat16_t* const dst, const std::size_t size) {
+			conversion_statistics statistics;
+			kernels::convert_float_to_bfloat16_instrumented(src, dst, size, statistics);
+		}
+
+		inline std::vector<kernel_entry<float_to_bfloat16_kernel>> float_to_bfloat16_kernels() {
+			return {
+				{ kernels::scalar::name(), "convert_float_to_bfloat16", kernels::scalar::convert_float_to_bfloat16 },
+#ifdef BIOVAULT_BFLOAT16_HAS_SSE2
+				{ kernels::sse2::name(), "convert_float_to_bfloat16", kernels::sse2::convert_float_to_bfloat16 },
+#endif
+#ifdef BIOVAULT_BFLOAT16_HAS_AVX2
+				{ kernels::avx2::name(), "convert_float_to_bfloat16", kernels::avx2::convert_float_to_bfloat16 },
+#endif
+				{ kernels::native::name(), "convert_float_to_bfloat16_and_classify", convert_and_classify },
+				{ kernels::native::name(), "convert_float_to_bfloat16_instrumented", convert_instrumented }
+			};
+		}
+
+		inline std::vector<kernel_entry<bfloat16_to_float_kernel>> bfloat16_to_float_kernels() {
+			return {
+				{ kernels::scalar::name(), "convert_bfloat16_to_float", kernels::scalar::convert_bfloat16_to_float },
+#ifdef BIOVAULT_BFLOAT16_HAS_SSE2
+				{ kernels::sse2::name(), "convert_bfloat16_to_float", kernels::sse2::convert_bfloat16_to_float },
+#endif
+#ifdef BIOVAULT_BFLOAT16_HAS_AVX2
+				{ kernels::avx2::name(), "convert_bfloat16_to_float", kernels::avx2::convert_bfloat16_to_float },
+#endif
+			};
+		}
+
+		inline std::uint64_t input_count(const std::uint64_t input_space_size, const std::uint64_t stride) {
+			return (input_space_size + stride - 1) / stride;
+		}
+
+		// Sweeps the input indices k in [0, input_count), block by block, over
+		// multiple threads. For each block, fill_and_compare(first_k, count,
+		// local_results) must add the mismatches of each kernel to the
+		// corresponding local result.
+		template <typename FillAndCompare>
+		std::vector<kernel_verification_result> sweep(std::vector<kernel_verification_result> results,
+			const unsigned thread_count, FillAndCompare fill_and_compare) {
+			const auto total_input_count = results.empty() ? std::uint64_t{} : results.front().input_count;
+			const auto block_count = static_cast<std::size_t>((total_input_count + block_size - 1) / block_size);
+			std::vector<std::vector<kernel_verification_result>> per_thread_results(
+				(thread_count == 0) ? default_thread_count() : thread_count);
+
+			parallel_for_ranges(block_count, thread_count,
+				[&](const std::size_t begin, const std::size_t end, const std::size_t range_index) {
+				auto local_results = results;
+
+				for (auto block_index = begin; block_index < end; ++block_index) {
+					const std::uint64_t first_k{ std::uint64_t{ block_index } * block_size };
+					const auto count = static_cast<std::size_t>(std::min<std::uint64_t>(block_size, total_input_count - first_k));
+					fill_and_compare(first_k, count, local_results);
+				}
+				per_thread_results[range_index] = local_results;
+			});
+
+			// Merge in range order, so that the first mismatch is the lowest one.
+			for (const auto& thread_results : per_thread_results) {
+				for (std::size_t i{}; i < thread_results.size(); ++i) {
+					if ((results[i].mismatch_count == 0) && (thread_results[i].mismatch_count > 0)) {
+						results[i].first_mismatch = thread_results[i].first_mismatch;
+					}
+					results[i].mismatch_count += thread_results[i].mismatch_count;
+				}
+			}
+			return results;
+		}
+
+		inline void record_mismatches(const std::uint16_t* const expected, const bfloat16_t* const actual, const std::size_t count,
+			const std::uint64_t first_k, const std::uint64_t stride, kernel_verification_result& result) {
+			for (std::size_t i{}; i < count; ++i) {
+				if (get_raw_bits(actual[i]) != expected[i]) {
+					if (result.mismatch_count == 0) {
+						result.first_mismatch = static_cast<std::uint32_t>((first_k + i) * stride);
+					}
+					++result.mismatch_count;
+				}
+			}
+		}
+	}
+
+
+	// Verifies each float to bfloat16 kernel against the bfloat16_t(float)
+	// constructor, for the float inputs whose bits are k * stride.
+	inline std::vector<kernel_verification_result> verify_float_to_bfloat16_kernels(
+		const std::uint64_t stride = 1, const unsigned thread_count = 0)
+	{
+		using namespace verification_detail;
+		const auto kernel_entries = float_to_bfloat16_kernels();
+		std::vector<kernel_verification_result> results;
+
+		for (const auto& entry : kernel_entries) {
+			results.push_back({ entry.isa, entry.name, input_count(std::uint64_t{ 1 } << 32U, stride) });
+		}
+
+		return sweep(results, thread_count,
+			[&kernel_entries, stride](const std::uint64_t first_k, const std::size_t count, std::vector<kernel_verification_result>& local_results) {
+			std::vector<float> inputs(count);
+			std::vector<std::uint16_t> expected(count);
+			std::vector<bfloat16_t> actual(count);
+
+			for (std::size_t i{}; i < count; ++i) {
+				const auto bits = static_cast<std::uint32_t>((first_k + i) * stride);
+				std::memcpy(&inputs[i], &bits, sizeof(bits));
+				expected[i] = get_raw_bits(bfloat16_t{ inputs[i] });
+			}
+			for (std::size_t kernel_index{}; kernel_index < kernel_entries.size(); ++kernel_index) {
+				kernel_entries[kernel_index].kernel(inputs.data(), actual.data(), count);
+				record_mismatches(expected.data(), actual.data(), count, first_k, stride, local_results[kernel_index]);
+			}
+		});
+	}
+
+	// Verifies the conversion from 32-bit signed and unsigned integers against
+	// conversion from the float value of the integer, for the integer inputs
+	// whose bits are k * stride.
+	inline std::vector<kernel_verification_result> verify_integer_to_bfloat16_conversion(
+		const std::uint64_t stride = 1, const unsigned thread_count = 0)
+	{
+		using namespace verification_detail;
+		const auto count_per_kernel = input_count(std::uint64_t{ 1 } << 32U, stride);
+
+		return sweep({ { kernels::scalar::name(), "bfloat16_t(std::int32_t)", count_per_kernel },
+			{ kernels::scalar::name(), "bfloat16_t(std::uint32_t)", count_per_kernel } },
+			thread_count,
+			[stride](const std::uint64_t first_k, const std::size_t count, std::vector<kernel_verification_result>& local_results) {
+			std::vector<std::uint16_t> expected(count);
+			std::vector<bfloat16_t> actual(count);
+
+			for (std::size_t i{}; i < count; ++i) {
+				const auto bits = static_cast<std::uint32_t>((first_k + i) * stride);
+				std::int32_t signed_value;
+				std::memcpy(&signed_value, &bits, sizeof(bits));
+				expected[i] = get_raw_bits(bfloat16_t{ static_cast<float>(signed_value) });
+				actual[i] = bfloat16_t{ signed_value };
+			}
+			record_mismatches(expected.data(), actual.data(), count, first_k, stride, local_results[0]);
+
+			for (std::size_t i{}; i < count; ++i) {
+				const auto bits = static_cast<std::uint32_t>((first_k + i) * stride);
+				expected[i] = get_raw_bits(bfloat16_t{ static_cast<float>(bits) });
+				actual[i] = bfloat16_t{ bits };
+			}
+			record_mismatches(expected.data(), actual.data(), count, first_k, stride, local_results[1]);
+		});
+	}
+
+	// Verifies each bfloat16 to float kernel against the float conversion
+	// operator, for all 2^16 inputs.
+	inline std::vector<kernel_verification_result> verify_bfloat16_to_float_kernels()
+	{
+		using namespace verification_detail;
+		constexpr std::size_t count{ std::size_t{ std::numeric_limits<std::uint16_t>::max() } + 1 };
+		std::vector<bfloat16_t> inputs(count);
+		std::vector<std::uint32_t> expected(count);
+		std::vector<float> actual(count);
+		std::vector<kernel_verification_result> results;
+
+		for (std::size_t i{}; i < count; ++i) {
+			inputs[i] = bfloat16_t(static_cast<std::uint16_t>(i), true);
+			const float f{ inputs[i] };
+			std::memcpy(&expected[i], &f, sizeof(f));
+		}
+
+		for (const auto& entry : bfloat16_to_float_kernels()) {
+			kernel_verification_result result{ entry.isa, entry.name, count };
+			entry.kernel(inputs.data(), actual.data(), count);
+
+			for (std::size_t i{}; i < count; ++i) {
+				std::uint32_t actual_bits;
+				std::memcpy(&actual_bits, &actual[i], sizeof(actual_bits));
+
+				// A signaling NaN may be quieted by the float conversion operator
+				// itself (depending on the compiler), so compare NaNs after quieting.
+				const bool is_nan{ (expected[i] & 0x7FFFFFFFU) > 0x7F800000U };
+				const auto quiet_bit = is_nan ? std::uint32_t{ 0x00400000U } : std::uint32_t{};
+
+				if ((actual_bits | quiet_bit) != (expected[i] | quiet_bit)) {
+					if (result.mismatch_count == 0) {
+						result.first_mismatch = i;
+					}
+					++result.mismatch_count;
+				}
+			}
+			results.push_back(result);
+		}
+		return results;
+	}
+
+	// Verifies all conversion kernels, and returns a result per kernel and ISA.
+	// With the default stride of one, this covers the entire input space.
+	inline std::vector<kernel_verification_result> verify_all_conversion_kernels(
+		const std::uint64_t stride = 1, const unsigned thread_count = 0)
+	{
+		auto results = verify_float_to_bfloat16_kernels(stride, thread_count);
+
+		for (auto&& more_results : { verify_integer_to_bfloat16_conversion(stride, thread_count), verify_bfloat16_to_float_kernels() }) {
+			results.insert(results.end(), more_results.cbegin(), more_results.cend());
+		}
+		return results;
+	}
+
+	// Writes a report of the specified results, one line per kernel.
+	inline void write_verification_report(std::ostream& stream, const std::vector<kernel_verification_result>& results)
+	{
+		for (const auto& result : results) {
+			stream << result.isa << '\t' << result.kernel_name << '\t' << result.input_count << " inputs\t";
+
+			if (result.passed()) {
+				stream << "bit-exact\n";
+			}
+			else {
+				stream << result.mismatch_count << " mismatches (first input bits: 0x" << std::hex << result.first_mismatch
+					<< std::dec << ")\n";
+			}
+		}
+	}
+}
+
+#endif
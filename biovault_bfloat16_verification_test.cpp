@@ -0,0 +1,109 @@
+/*******************************************************************************
+* Copyright 2020 LKEB, Leiden University Medical Center
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*******************************************************************************/
+
+// The file to be tested. Included twice here, to check its include guards!
+#include "biovault_bfloat16_verification.h"
+#include "biovault_bfloat16_verification.h"
+
+// GoogleTest header file:
+#include <gtest/gtest.h>
+
+// Standard library header files:
+#include <cstdint>
+#include <iostream>
+#include <sstream>
+#include <vector>
+
+
+namespace
+{
+#ifndef BIOVAULT_BFLOAT16_EXHAUSTIVE_TEST
+#  if defined(NDEBUG)
+#  define BIOVAULT_BFLOAT16_EXHAUSTIVE_TEST 1
+#  else
+#  define BIOVAULT_BFLOAT16_EXHAUSTIVE_TEST 0
+#  endif
+#endif
+	constexpr bool exhaustive{ BIOVAULT_BFLOAT16_EXHAUSTIVE_TEST };
+
+	// A prime stride, so that the subset of inputs has varying lower bits.
+	constexpr std::uint64_t quick_stride{ 65521 };
+
+
+	void expect_all_passed(const std::vector<biovault::kernel_verification_result>& results)
+	{
+		EXPECT_FALSE(results.empty());
+
+		for (const auto& result : results)
+		{
+			EXPECT_TRUE(result.passed()) << result.isa << ' ' << result.kernel_name << ": "
+				<< result.mismatch_count << " mismatches, first input bits: " << result.first_mismatch;
+			EXPECT_GT(result.input_count, 0U);
+		}
+	}
+}
+
+
+GTEST_TEST(bfloat16_verification, FloatToBfloat16KernelsMatchConstructorForSubsetOfInputs)
+{
+	const auto results = biovault::verify_float_to_bfloat16_kernels(quick_stride, 3);
+
+	expect_all_passed(results);
+	EXPECT_EQ(results.front().input_count, ((std::uint64_t{ 1 } << 32U) + quick_stride - 1) / quick_stride);
+}
+
+
+GTEST_TEST(bfloat16_verification, IntegerConversionMatchesConversionFromFloatForSubsetOfInputs)
+{
+	expect_all_passed(biovault::verify_integer_to_bfloat16_conversion(quick_stride, 3));
+}
+
+
+GTEST_TEST(bfloat16_verification, Bfloat16ToFloatKernelsMatchConversionOperator)
+{
+	const auto results = biovault::verify_bfloat16_to_float_kernels();
+
+	expect_all_passed(results);
+	EXPECT_EQ(results.front().input_count, 1U << 16U);
+}
+
+
+GTEST_TEST(bfloat16_verification, ReportHasOneLinePerKernel)
+{
+	biovault::kernel_verification_result failed_result{ "isa", "kernel", 42 };
+	failed_result.mismatch_count = 2;
+	failed_result.first_mismatch = 0x7F80;
+
+	std::ostringstream stream;
+	biovault::write_verification_report(stream, { { "scalar", "convert", 42 }, failed_result });
+
+	EXPECT_EQ(stream.str(),
+		"scalar\tconvert\t42 inputs\tbit-exact\n"
+		"isa\tkernel\t42 inputs\t2 mismatches (first input bits: 0x7f80)\n");
+}
+
+
+GTEST_TEST(bfloat16_verification, AllConversionKernelsAreBitExactForAllInputs)
+{
+	if (exhaustive)
+	{
+		// Sweeps all 2^32 float and integer inputs, using all hardware threads.
+		const auto results = biovault::verify_all_conversion_kernels();
+
+		biovault::write_verification_report(std::cout, results);
+		expect_all_passed(results);
+	}
+}